@@ -0,0 +1,186 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+/* Fixcmp reads a level from standard input, drops bodies onto it, and
+ * moves each of them with both bodyupdatedbl and bodyupdatefix,
+ * reporting where their trajectories part and how long each takes.
+ * The bodies walk, turn at walls and jump like the enemies' AI, so
+ * starting on the 1/256 grid no pair should ever part.  With -d,
+ * walking speeds are scaled by the water drag (0.7), which is off the
+ * grid, so every pair parts at once, and turning at walls soon
+ * carries the two far apart.  Exits 1 if pairs part without -d. */
+
+#include "../../include/mid.h"
+#include "../../include/log.h"
+#include "../../include/rng.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+enum { Defbodies = 500, Defticks = 1000, Jumpticks = 40 };
+
+typedef struct Walker Walker;
+struct Walker {
+	Body body;
+	double wv;	/* walking velocity */
+	double lastx;
+};
+
+static Walker *spawn(Lvl *, int n, bool drag);
+static double run(Walker *, int n, int ticks, Lvl *, void (*)(Body *, Lvl *));
+static void step(Walker *, Lvl *, void (*)(Body *, Lvl *), int t);
+static double ptdiff(Point, Point);
+static bool spot(Lvl *, Rng *, int *x, int *y);
+static char *readin(void);
+
+int main(int argc, char *argv[])
+{
+	int nbodies = Defbodies, nticks = Defticks;
+	bool drag = false;
+
+	loginit(NULL);
+
+	int a = 1;
+	if (a < argc && strcmp(argv[a], "-d") == 0) {
+		drag = true;
+		a++;
+	}
+	if (a < argc)
+		nbodies = strtol(argv[a++], NULL, 10);
+	if (a < argc)
+		nticks = strtol(argv[a++], NULL, 10);
+	if (a < argc || nbodies <= 0 || nticks <= 0)
+		fatal("usage: fixcmp [-d] [<bodies> [<ticks>]]");
+
+	char *buf = readin();
+	char *p = buf;
+	Lvl *l = lvlscan(&p);
+	if (!l)
+		die("Failed to scan the level: %s", miderrstr());
+
+	Walker *d = spawn(l, nbodies, drag);
+	Walker *f = spawn(l, nbodies, drag);
+	double dblsecs = run(d, nbodies, nticks, l, bodyupdatedbl);
+	double fixsecs = run(f, nbodies, nticks, l, bodyupdatefix);
+	xfree(d);
+	xfree(f);
+
+	// Again in lock step, to find where each pair first parts.
+	d = spawn(l, nbodies, drag);
+	f = spawn(l, nbodies, drag);
+	bool *parted = xalloc(nbodies, sizeof(*parted));
+	int nparted = 0, first = -1;
+	double maxd = 0;
+	for (int t = 0; t < nticks; t++) {
+		for (int i = 0; i < nbodies; i++) {
+			step(&d[i], l, bodyupdatedbl, t);
+			step(&f[i], l, bodyupdatefix, t);
+			double dd = ptdiff(d[i].body.bbox.a, f[i].body.bbox.a);
+			if (dd > maxd)
+				maxd = dd;
+			if (parted[i] || (dd == 0 && d[i].body.fall == f[i].body.fall
+					&& ptdiff(d[i].body.vel, f[i].body.vel) == 0))
+				continue;
+			parted[i] = true;
+			nparted++;
+			if (first < 0)
+				first = t;
+		}
+	}
+
+	printf("%d bodies, %d ticks%s\n", nbodies, nticks, drag ? ", with drag" : "");
+	printf("double: %g us/body-tick\n", dblsecs * 1e6 / nbodies / nticks);
+	printf("fixed: %g us/body-tick\n", fixsecs * 1e6 / nbodies / nticks);
+	printf("%d bodies parted", nparted);
+	if (nparted > 0)
+		printf(", first at tick %d", first);
+	printf("; max distance %g px\n", maxd);
+
+	xfree(parted);
+	xfree(d);
+	xfree(f);
+	lvlfree(l);
+	xfree(buf);
+	return nparted > 0 && !drag;
+}
+
+/* Make n walkers at random spots, the same ones on each call. */
+static Walker *spawn(Lvl *l, int n, bool drag)
+{
+	Rng rng;
+	rnginit(&rng, 1);
+	Walker *ws = xalloc(n, sizeof(*ws));
+	for (int i = 0; i < n; i++) {
+		int x, y;
+		if (!spot(l, &rng, &x, &y))
+			die("No open blocks in the level");
+		bodyinit(&ws[i].body, x * Twidth, y * Theight, Twidth, Theight);
+		ws[i].wv = (int) rngintincl(&rng, 1, 4) * (rngintincl(&rng, 0, 1) ? 1 : -1);
+		if (drag)
+			ws[i].wv *= blkdrag(Twater);
+		ws[i].lastx = -1;
+	}
+	return ws;
+}
+
+/* Run the walkers for the ticks, returning the seconds taken. */
+static double run(Walker *ws, int n, int ticks, Lvl *l, void (*update)(Body *, Lvl *))
+{
+	clock_t start = clock();
+	for (int t = 0; t < ticks; t++) {
+		for (int i = 0; i < n; i++)
+			step(&ws[i], l, update, t);
+	}
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Move w for tick t, walking it and turning it around at walls like
+ * aiwalker and jumping it every Jumpticks ticks like aijumper. */
+static void step(Walker *w, Lvl *l, void (*update)(Body *, Lvl *), int t)
+{
+	Body *b = &w->body;
+	if (b->bbox.a.x == w->lastx)
+		w->wv = -w->wv;
+	w->lastx = b->bbox.a.x;
+	b->vel.x = w->wv;
+	if (!b->fall && t % Jumpticks == 0) {
+		b->vel.y = -8;
+		b->fall = true;
+	}
+	bodystart(b);
+	update(b, l);
+}
+
+static double ptdiff(Point a, Point b)
+{
+	return fmax(fabs(a.x - b.x), fabs(a.y - b.y));
+}
+
+/* Pick a random open block with an open block below it. */
+static bool spot(Lvl *l, Rng *rng, int *x, int *y)
+{
+	for (int tries = 0; tries < 100000; tries++) {
+		*x = rngintincl(rng, 1, l->w - 2);
+		*y = rngintincl(rng, 1, l->h - 3);
+		if (!lvlhas(l, *x, *y, 0, Pcollide) && !lvlhas(l, *x, *y + 1, 0, Pcollide))
+			return true;
+	}
+	return false;
+}
+
+static char *readin(void)
+{
+	size_t n = 0, sz = 4096;
+	char *buf = xalloc(sz, 1);
+
+	while ((n += fread(buf + n, 1, sz - n - 1, stdin)) == sz - 1) {
+		sz *= 2;
+		buf = xrealloc(buf, sz);
+	}
+	if (ferror(stdin))
+		die("Failed to read the level");
+
+	buf[n] = '\0';
+	return buf;
+}
@@ -110,7 +110,8 @@ static void init(Lvl *l)
 		int c = ' ';
 		if (x == 0 || x == l->w - 1 || y == 0 || y == l->h - 1)
 			c = '#';
-		*blk(l, x, y, z) = (Blk) { .tile = c };
+		*blk(l, x, y, z) = (Blk) { 0 };
+		lvlsettile(l, x, y, z, c);
 	}
 	}
 	}
@@ -123,10 +124,10 @@ unsigned int rnd(int min, int max)
 
 static void stairs(Rng *r, Lvl *lvl, unsigned int x0, unsigned int y0)
 {
-	if (tileinfo(lvl, x0, y0, 0).flags & Twater)
-		blk(lvl, x0, y0, 0)->tile = 'U';
+	if (lvlhas(lvl, x0, y0, 0, Pwater))
+		lvlsettile(lvl, x0, y0, 0, 'U');
 	else
-		blk(lvl, x0, y0, 0)->tile = 'u';
+		lvlsettile(lvl, x0, y0, 0, 'u');
 	setreach(lvl, x0, y0, 0);
 
 	Loc ls[lvl->w * lvl->h * lvl->d];
@@ -135,10 +136,10 @@ static void stairs(Rng *r, Lvl *lvl, unsigned int x0, unsigned int y0)
 		fatal("No stair locations");
 
 	Loc l = ls[rnd(0, nls - 1)];
-	if (tileinfo(lvl, l.x, l.y, l.z).flags & Twater)
-		blk(lvl, l.x, l.y, l.z)->tile = 'D';
+	if (lvlhas(lvl, l.x, l.y, l.z, Pwater))
+		lvlsettile(lvl, l.x, l.y, l.z, 'D');
 	else
-		blk(lvl, l.x, l.y, l.z)->tile = 'd';
+		lvlsettile(lvl, l.x, l.y, l.z, 'd');
 	setreach(lvl, l.x, l.y, l.z);
 }
 
@@ -148,7 +149,7 @@ static int stairlocs(Lvl *lvl, Loc ls[])
 	for (int z = 0; z < lvl->d; z++)
 	for (int x = 1; x < lvl->w-1; x++)
 	for (int y = 1; y < lvl->h-2; y++) {
-		if (reachable(lvl, x, y, z) &&  tileinfo(lvl, x, y+1, z).flags & Tcollide
+		if (reachable(lvl, x, y, z) &&  lvlhas(lvl, x, y+1, z, Pcollide)
 			&& !(tileinfo(lvl, x, y, z).flags & (Tfdoor | Tbdoor | Tup))) {
 			ls[nls] = (Loc){ x, y, z };
 			nls++;
@@ -166,5 +167,5 @@ void setreach(Lvl *l, int x, int y, int z)
 {
 	blk(l, x, y, z)->flags = 1;
 	if (blk(l, x, y, z)->tile == '.')
-		blk(l, x, y, z)->tile = ' ';
+		lvlsettile(l, x, y, z, ' ');
 }
\ No newline at end of file
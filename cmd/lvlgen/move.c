@@ -436,9 +436,8 @@ void mvblit(Mv *mv, Lvl *lvl, Loc l0)
 		if (clr)
 			setreach(lvl, loc.x, loc.y, loc.z);
 
-		Blk *b = blk(lvl, loc.x, loc.y, loc.z);
 		if (strchr(blkdtiles, t) != NULL)
-			b->tile = t;
+			lvlsettile(lvl, loc.x, loc.y, loc.z, t);
 		else if (strchr(doortiles, t) != NULL)
 			blitdoor(lvl, loc, t);
 	}
@@ -446,13 +445,13 @@ void mvblit(Mv *mv, Lvl *lvl, Loc l0)
 
 static void blitdoor(Lvl *lvl, Loc l, int door)
 {
-	if (tileinfo(lvl, l.x, l.y, l.z).flags & Twater) {
+	if (lvlhas(lvl, l.x, l.y, l.z, Pwater)) {
 		if (door == '<')
 			door = '(';
 		else if (door == '>')
 			door = ')';
 	}
-	blk(lvl, l.x, l.y, l.z)->tile = door;
+	lvlsettile(lvl, l.x, l.y, l.z, door);
 }
 
 static Loc indloc(Mvspec *s, int i)
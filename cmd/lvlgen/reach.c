@@ -34,7 +34,7 @@ static void expndreach(Lvl *lvl, int x, int y, int z)
 
 static void reach(Lvl *lvl, int x, int y, int z)
 {
-	if (tileinfo(lvl, x, y, z).flags & Tcollide || reachable(lvl, x, y, z))
+	if (lvlhas(lvl, x, y, z, Pcollide) || reachable(lvl, x, y, z))
 		return;
 	setreach(lvl, x, y, z);
 	expndreach(lvl, x, y, z);
@@ -66,10 +66,11 @@ void closeunits(Lvl *lvl)
 	for (int z = 0; z < lvl->d; z++) {
 	for (int x = 1; x < lvl->w - 1; x++) {
 	for (int y = 1; y < lvl->h - 1; y++) {
-		if (tileinfo(lvl, x-1, y, z).flags & Tcollide
-			&& tileinfo(lvl, x+1, y, z).flags & Tcollide
-			&& tileinfo(lvl, x, y+1, z).flags & Tcollide) {
-			*blk(lvl, x, y, z) = (Blk) { .tile = '#' };
+		if (lvlhas(lvl, x-1, y, z, Pcollide)
+			&& lvlhas(lvl, x+1, y, z, Pcollide)
+			&& lvlhas(lvl, x, y+1, z, Pcollide)) {
+			*blk(lvl, x, y, z) = (Blk) { 0 };
+			lvlsettile(lvl, x, y, z, '#');
 		}
 	}
 	}
@@ -87,9 +88,9 @@ int closeunreach(Lvl *lvl)
 			nreach++;
 			continue;
 		}
-		if (tileinfo(lvl, x, y, z).flags & Tcollide)
+		if (lvlhas(lvl, x, y, z, Pcollide))
 			continue;
-		blk(lvl, x, y, z)->tile = '#';
+		lvlsettile(lvl, x, y, z, '#');
 	}
 	}
 	}
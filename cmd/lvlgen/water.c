@@ -18,9 +18,8 @@ void water(Lvl *lvl)
 
 		for (int x = 0; x < lvl->w - 1; x++) {
 		for (int y = lvl->h - 2; y > lvl->h - 2 - ht; y--) {
-			Blk *b = blk(lvl, x, y, z);
-			if (b->tile == ' ')
-				b->tile = 'w';
+			if (blk(lvl, x, y, z)->tile == ' ')
+				lvlsettile(lvl, x, y, z, 'w');
 		}
 		}
 	}
@@ -0,0 +1,266 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
+#include "../../include/mid.h"
+#include "../../include/log.h"
+#include "../../include/os.h"
+#include "game.h"
+
+/* Files are written by a background thread so that saving doesn't
+ * stall the frame.  Each file is written to path.tmp and synced to
+ * the disk before it is renamed over path, so after a crash path
+ * holds either its old or its new contents.
+ *
+ * Jobs queued between bgbegin and bgend are a group, such as the
+ * files of a save.  If a job of a group fails, the rest of the group
+ * is dropped, since it may depend on the failed job, and the failure
+ * is reported by bgend.  Failures of other jobs are reported by the
+ * next bgsync. */
+
+enum { Pathsz = 1024, Errsz = 256 };
+
+typedef struct Bgjob Bgjob;
+struct Bgjob {
+	Bgjob *next;
+	char path[Pathsz];
+	// If rm is set then path is removed.  If src is non-empty
+	// then the file at src is copied to path, otherwise data is
+	// written to path.
+	bool rm;
+	char src[Pathsz];
+	Buf data;
+	unsigned long group;	// or 0 if it isn't in one
+};
+
+static SDL_Thread *thrd;
+static SDL_mutex *mtx;
+static SDL_cond *work, *idle;
+static Bgjob *head, *tail;
+static _Bool busy;
+// The first failure outside of a group since the last bgsync, or
+// empty.
+static char err[Errsz];
+// The group being queued, and the latest one with a failed job and
+// its failure.
+static unsigned long curgroup, ngroups, failgroup;
+static char grouperr[Errsz];
+// The current job's failure, only used by the I/O thread.
+static char joberr[Errsz];
+
+static Bgjob *jobnew(const char *path);
+static void enqueue(Bgjob *);
+static int bgthrd(void *);
+static bool jobdo(Bgjob *);
+static bool copyfile(FILE *, const char *src);
+static void fail(const char *fmt, ...);
+
+void bgwrite(const char *path, Buf data)
+{
+	Bgjob *j = jobnew(path);
+	j->data = data;
+	enqueue(j);
+}
+
+void bgcopy(const char *path, const char *src)
+{
+	Bgjob *j = jobnew(path);
+	if (snprintf(j->src, Pathsz, "%s", src) >= Pathsz)
+		die("Path is too long: %s", src);
+	enqueue(j);
+}
+
+void bgremove(const char *path)
+{
+	Bgjob *j = jobnew(path);
+	j->rm = true;
+	enqueue(j);
+}
+
+void bgbegin(void)
+{
+	curgroup = ++ngroups;
+}
+
+_Bool bgend(void)
+{
+	unsigned long group = curgroup;
+	curgroup = 0;
+	if (!thrd)
+		return true;
+
+	SDL_LockMutex(mtx);
+	while (head || busy)
+		SDL_CondWait(idle, mtx);
+	bool ok = failgroup != group;
+	if (!ok)
+		seterrstr("%s", grouperr);
+	SDL_UnlockMutex(mtx);
+	return ok;
+}
+
+_Bool bgsync(void)
+{
+	if (!thrd)
+		return true;
+
+	SDL_LockMutex(mtx);
+	while (head || busy)
+		SDL_CondWait(idle, mtx);
+	bool ok = err[0] == '\0';
+	if (!ok)
+		seterrstr("%s", err);
+	err[0] = '\0';
+	SDL_UnlockMutex(mtx);
+	return ok;
+}
+
+static Bgjob *jobnew(const char *path)
+{
+	Bgjob *j = xalloc(1, sizeof(*j));
+	if (snprintf(j->path, Pathsz, "%s", path) >= Pathsz)
+		die("Path is too long: %s", path);
+	j->group = curgroup;
+	return j;
+}
+
+static void enqueue(Bgjob *j)
+{
+	if (!thrd) {
+		mtx = SDL_CreateMutex();
+		work = SDL_CreateCond();
+		idle = SDL_CreateCond();
+		if (!mtx || !work || !idle)
+			die("Failed to create the I/O thread's locks: %s", miderrstr());
+		thrd = SDL_CreateThread(bgthrd, "bgio", NULL);
+		if (!thrd)
+			die("Failed to create the I/O thread: %s", miderrstr());
+		SDL_DetachThread(thrd);
+	}
+
+	SDL_LockMutex(mtx);
+	if (tail)
+		tail->next = j;
+	else
+		head = j;
+	tail = j;
+	SDL_CondSignal(work);
+	SDL_UnlockMutex(mtx);
+}
+
+static int bgthrd(void *unused)
+{
+	for (;;) {
+		SDL_LockMutex(mtx);
+		while (!head)
+			SDL_CondWait(work, mtx);
+		Bgjob *j = head;
+		head = j->next;
+		if (!head)
+			tail = NULL;
+		busy = true;
+		bool skip = j->group != 0 && j->group == failgroup;
+		SDL_UnlockMutex(mtx);
+
+		joberr[0] = '\0';
+		bool ok = skip || jobdo(j);
+		unsigned long group = j->group;
+		xfree(j->data.b);
+		xfree(j);
+
+		SDL_LockMutex(mtx);
+		if (!ok && group != 0) {
+			failgroup = group;
+			memcpy(grouperr, joberr, sizeof(grouperr));
+		} else if (!ok && err[0] == '\0') {
+			memcpy(err, joberr, sizeof(err));
+		}
+		busy = false;
+		if (!head)
+			SDL_CondBroadcast(idle);
+		SDL_UnlockMutex(mtx);
+	}
+	return 0;
+}
+
+static bool jobdo(Bgjob *j)
+{
+	if (j->rm) {
+		if (remove(j->path) != 0 && errno != ENOENT) {
+			fail("Failed to remove [%s]: %s", j->path, strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	char tmp[Pathsz + 4];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", j->path);
+
+	FILE *f = fopen(tmp, "wb");
+	if (!f) {
+		fail("Failed to open [%s] for writing: %s", tmp, strerror(errno));
+		return false;
+	}
+
+	// fail keeps the first error, so copyfile's is reported over
+	// this one.
+	bool ok;
+	if (j->src[0])
+		ok = copyfile(f, j->src);
+	else
+		ok = fwrite(j->data.b, 1, j->data.n, f) == j->data.n;
+	if (!ok || ferror(f) || filesync(f) != 0) {
+		fail("Failed to write [%s]: %s", tmp, strerror(errno));
+		fclose(f);
+		remove(tmp);
+		return false;
+	}
+	if (fclose(f) != 0) {
+		fail("Failed to close [%s]: %s", tmp, strerror(errno));
+		remove(tmp);
+		return false;
+	}
+
+	if (filereplace(tmp, j->path) != 0) {
+		fail("Failed to rename [%s] to [%s]: %s", tmp, j->path, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+static bool copyfile(FILE *f, const char *src)
+{
+	FILE *in = fopen(src, "rb");
+	if (!in) {
+		fail("Failed to open [%s] for reading: %s", src, strerror(errno));
+		return false;
+	}
+
+	char buf[4096];
+	size_t n;
+	bool ok = true;
+	while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+		ok = fwrite(buf, 1, n, f) == n;
+	if (ferror(in)) {
+		fail("Failed to read [%s]: %s", src, strerror(errno));
+		ok = false;
+	}
+	fclose(in);
+	return ok;
+}
+
+/* Records the failure of the current job. */
+static void fail(const char *fmt, ...)
+{
+	if (joberr[0] != '\0')
+		return;
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(joberr, sizeof(joberr), fmt, ap);
+	va_end(ap);
+}
@@ -83,6 +83,10 @@ static void handle(Scrn *s, Scrnstk *stk, Event *e){
 }
 
 static void goverfree(Scrn *s){
+	Txtinfo ti = { TxtSzLarge, { 255, 255, 255 } };
+	resrcrel(txt, TxtStyleMenu, &ti);
+	ti.size = TxtSzMedium;
+	resrcrel(txt, TxtStyleMenu, &ti);
 }
 
 static char *praise(int m){
@@ -18,22 +18,34 @@
 
 static char savedir[128] = "_save";
 
+/* The game file starts with savemagic followed by the packed game
+ * information.  Older saves are a line of text.
+ *
+ * Each save writes its zone files under a new generation number,
+ * which is packed last in the game file.  Since the game file is
+ * replaced atomically after its zones are written, a crash part way
+ * through a save leaves the previous save whole.  Saves from before
+ * generations have generation 0. */
+static const char savemagic[4] = { 0x7f, 'm', 'i', 'd' };
+
 static void dropall(Zone*, Player*);
 static void ldresrc();
 static void rmrecur(const char *);
 static FILE *opensavefile(const char *file, const char *mode);
 static const char *savepath(const char *file);
-static _Bool readl(char *buf, int sz, FILE *f);
+static const char *savezone(int znum, int gen);
 
 struct Game {
 	Player player;
 	Point transl;
+	Point lasttr;	/* the latest tick's part of transl */
 	_Bool died;
 	int znum, zmax;
 	Zone *zone;
 	Rng rng;
 	Msg msg;
 	Img *ui;
+	int savegen;	/* generation of the latest save's zone files */
 };
 
 Game *gamenew(void)
@@ -50,6 +62,7 @@ Game *gamenew(void)
 	gm.zone = zonegen(&gm.rng);
 	if (!gm.zone)
 		fatal("Failed to load zone: %s", miderrstr());
+	zoneput(gm.zone, gm.znum);
 
 	playerinit(&gm.player, 2, 2);
 
@@ -62,20 +75,25 @@ Game *gamenew(void)
 void gamefree(Scrn *s)
 {
 	Game *gm = s->data;
-	zonefree(gm->zone);
+	playerfree(&gm->player);
 	zonecleanup(gm->zmax);
+	resrcrel(imgs, "img/ui.png", 0);
 	*gm = (Game){};
 }
 
 static void trystairs(Scrnstk *stk, Game *gm)
 {
-	if (gm->zone->updown == Gonone)
+	int updown = gm->zone->updown;
+	if (updown == Gonone)
 		return;
 
+	// The zone stays in the cache, so it must be off the stairs
+	// when the player comes back to it.
+	gm->zone->updown = Gonone;
 	Point loc0 = gm->player.body.bbox.a;
 	zoneput(gm->zone, gm->znum);
 
-	if (gm->zone->updown == Goup) {
+	if (updown == Goup) {
 		gm->znum--;
 		if (gm->znum < 0) {
 			pr("You just left the dungeon");
@@ -90,11 +108,12 @@ static void trystairs(Scrnstk *stk, Game *gm)
 		playersetloc(&gm->player, bi.x, bi.y);
 
 		lvlsetpallet(lvlpallet(gm));
-	} else if (gm->zone->updown == Godown) {
+	} else if (updown == Godown) {
 		gm->znum++;
 		if (gm->znum > gm->zmax) {
 			gm->zmax = gm->znum;
 			gm->zone = zonegen(&gm->rng);
+			zoneput(gm->zone, gm->znum);
 		} else {
 			gm->zone = zoneget(gm->znum);
 		}
@@ -127,6 +146,7 @@ void gameupdate(Scrn *s, Scrnstk *stk)
 	zoneupdate(gm->zone, &gm->player, &tr);
 	gm->transl.x += tr.x;
 	gm->transl.y += tr.y;
+	gm->lasttr = tr;
 
 	trystairs(stk, gm);
 	if(gm->player.curhp <= 0 && !debugging){
@@ -149,6 +169,7 @@ void gameupdate(Scrn *s, Scrnstk *stk)
 			gm->player.lives--;
 			gm->transl.x = 0;
 			gm->transl.y = 0;
+			gm->lasttr = (Point){};
 			gm->zone->lvl->z = 0;
 
 			int lose = rngintincl(&gm->rng, 0, Maxinv-1);
@@ -213,7 +234,11 @@ void gamedraw(Scrn *s, Gfx *g)
 		gm->transl = (Point){};
 	}
 
+	// The camera is also drawn between the last two ticks.
+	Point off = ticklerp((Point){ -gm->lasttr.x, -gm->lasttr.y }, (Point){});
+	cammove(g, off.x, off.y);
 	zonedraw(g, gm->zone, &gm->player);
+	cammove(g, -off.x, -off.y);
 
 	int maxhp = gm->player.stats[StatHp] + gm->player.eqp[StatHp];
 	Meter lm = {
@@ -283,23 +308,13 @@ void saveloc(const char *l)
 
 void gamesave(Game *gm)
 {
-	ignframetime();
 	if (!ensuredir(savedir))
 		die("Failed to make the save directory: %s", miderrstr());
 
-	for (int i = 0; i <= gm->zmax; i++) {
-		char zfile[128];
-		if (snprintf(zfile, sizeof(zfile), "%d.zone", i) > sizeof(zfile))
-			die("Buffer is too small for the save's zone file");
-
-		const char *p = savepath(zfile);
-		FILE *f = fopen(p, "w");
-		if (!f)
-			die("Failed to open zone file for writing [%s]: %s", p, miderrstr());
-		Zone *z = i == gm->znum ? gm->zone : zoneget(i);
-		zonewrite(f, z);
-		fclose(f);
-	}
+	int gen = gm->savegen + 1;
+	bgbegin();
+	for (int i = 0; i <= gm->zmax; i++)
+		zonesave(i, savezone(i, gen));
 
 	Point ploc = gm->player.body.bbox.a;
 	Point c = (Point){ Scrnw/2 - Wide, Scrnh/2 - Tall };
@@ -310,13 +325,30 @@ void gamesave(Game *gm)
 	Player player = gm->player;
 	player.imgloc = c;
 
-	FILE *f = opensavefile("game", "w");
 	static char buf[4096];
-	if (!printgeom(buf, sizeof(buf), "pbdddul", tr, gm->died, gm->znum, gm->zmax, gm->zone->lvl->z, gm->rng.v, player))
-		die("Failed to serialize the game information");
-	fputs(buf, f);
-	fputc('\n', f);
-	fclose(f);
+	int n = packgeom(buf, sizeof(buf), "pbddduld",
+		tr, gm->died, gm->znum, gm->zmax, gm->zone->lvl->z, gm->rng.v, player, gen);
+	if (n < 0)
+		die("Failed to serialize the game information: %s", miderrstr());
+
+	Buf b = {};
+	bufput(&b, savemagic, sizeof(savemagic));
+	bufput(&b, buf, n);
+	bgwrite(savepath("game"), b);
+
+	// Only once the game file refers to the new generation can
+	// the old one go.  If the save failed, the game file still
+	// refers to the old one, and the new one is removed instead.
+	int old = gm->savegen;
+	if (bgend()) {
+		gm->savegen = gen;
+	} else {
+		pr("Failed to save the game: %s", miderrstr());
+		msg(&gm->msg, "Failed to save the game");
+		old = gen;
+	}
+	for (int i = 0; i <= gm->zmax; i++)
+		bgremove(savezone(i, old));
 }
 
 Game *gameload()
@@ -332,27 +364,40 @@ Game *gameload()
 	
 	static char buf[4096];
 
-	FILE *f = opensavefile("game", "r");
-	if (!readl(buf, sizeof(buf), f))
-		die("Failed to read the game save file: %s", miderrstr());
+	if (!bgsync())
+		pr("Failed to save the game: %s", miderrstr());
+	FILE *f = opensavefile("game", "rb");
+	size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+	if (ferror(f))
+		die("Failed to read the game save file: %s", strerror(errno));
 	fclose(f);
+	buf[n] = '\0';
+
 	int z = 0;
-	if (!scangeom(buf, "pbdddul", &gm.transl, &gm.died, &gm.znum, &gm.zmax, &z, &gm.rng.v, &gm.player))
+	_Bool ok;
+	if (n >= sizeof(savemagic) && memcmp(buf, savemagic, sizeof(savemagic)) == 0) {
+		char *p = buf + sizeof(savemagic);
+		int sz = n - sizeof(savemagic);
+		ok = unpackgeom(p, sz, "pbddduld",
+			&gm.transl, &gm.died, &gm.znum, &gm.zmax, &z, &gm.rng.v, &gm.player, &gm.savegen);
+		if (!ok)	// From before save generations.
+			ok = unpackgeom(p, sz, "pbdddul",
+				&gm.transl, &gm.died, &gm.znum, &gm.zmax, &z, &gm.rng.v, &gm.player);
+	} else	// A text save from before saves were packed.
+		ok = scangeom(buf, "pbdddul", &gm.transl, &gm.died, &gm.znum, &gm.zmax, &z, &gm.rng.v, &gm.player);
+	if (!ok)
 		die("Failed to deserialize the game information: %s", miderrstr());
 
 	for (int i = 0; i <= gm.zmax; i++) {
-		char zfile[128];
-		if (snprintf(zfile, sizeof(zfile), "%d.zone", i) > sizeof(zfile))
-			die("Buffer is too small for the save's zone file: %s", miderrstr());
-
-		const char *p = savepath(zfile);
+		const char *p = savezone(i, gm.savegen);
 		FILE *f = fopen(p, "r");
 		if (!f)
 			die("Failed to open zone file for reading [%s]: %s", p, miderrstr());
 		Zone *z = zoneread(f);
+		if (!z)
+			die("Failed to read zone file [%s]: %s", p, miderrstr());
 		zoneput(z, i);
 		fclose(f);
-		zonefree(z);
 	}
 
 	gm.zone = zoneget(gm.znum);
@@ -370,6 +415,8 @@ static void ldresrc()
 		fatal("Failed to load env resources: %s", miderrstr());
 	if(!enemyldresrc())
 		fatal("Failed to load enemy resrouces: %s", miderrstr());
+	if(!partldresrc())
+		fatal("Failed to load particle resources: %s", miderrstr());
 	if(!swordldresrc())
 		fatal("Failed to load sword resrouces: %s", miderrstr());
 }
@@ -385,6 +432,8 @@ static FILE *opensavefile(const char *file, const char *mode)
 
 void rmsave()
 {
+	if (!bgsync())
+		pr("Failed to save the game: %s", miderrstr());
 	if (!saveavailable())
 		return;
 	rmrecur(savedir);
@@ -447,6 +496,8 @@ rm:
 
 _Bool saveavailable()
 {
+	if (!bgsync())
+		pr("Failed to save the game: %s", miderrstr());
 	struct stat sb;
 	if (stat(savepath("game"), &sb) < 0) {
 		return false;
@@ -465,22 +516,15 @@ static const char *savepath(const char *file)
 	return path;
 }
 
-// TODO(eaburns): de-duplicate this and the one in ../../lib/mid/zone.c.
-static _Bool readl(char *buf, int sz, FILE *f)
+// Non-reentant
+static const char *savezone(int znum, int gen)
 {
-	extern int isspace(int);
-	char *r = fgets(buf, sz, f);
-	if (!r) {
-		pr("fgets returned NULL");
-		return 0;
-	}
-
-	int l = strlen(buf);
-
-	for(int i = l-1; i >= 0 && isspace(buf[i]); i--)
-		buf[i] = 0;
-
-	return 1;
+	char zfile[128];
+	if (gen == 0)
+		snprintf(zfile, sizeof(zfile), "%d.zone", znum);
+	else
+		snprintf(zfile, sizeof(zfile), "%d-%d.zone", znum, gen);
+	return savepath(zfile);
 }
 
 _Bool ensuredir(const char *d)
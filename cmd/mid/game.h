@@ -5,9 +5,14 @@ struct Rng;
 void zoneloc(const char*);
 /* Notify zone loader to use stdin for the next zone. */
 void zonestdin();
+/* Zones returned by zoneget and given to zoneput belong to the zone
+ * cache.  They stay valid until a zoneget or zoneput for a different
+ * zone number may have evicted them, and are freed by zonecleanup. */
 Zone *zoneget(int);
 Zone *zonegen(struct Rng *r);
 void zoneput(Zone *, int);
+/* Save zone number znum to the file at path in the background. */
+void zonesave(int znum, const char *path);
 void zonecleanup(int zmax);
 // Find the down stairs in this zone.
 Tileinfo zonedstairs(Zone *zn);
@@ -37,6 +42,24 @@ Scrn *optscrnnew(void);
 
 _Bool ensuredir(const char *d);
 
+/* Write data to the file at path on the background I/O thread, which
+ * takes ownership of data.b.  The file is replaced atomically. */
+void bgwrite(const char *path, Buf data);
+/* Copy the file at src to path on the background I/O thread. */
+void bgcopy(const char *path, const char *src);
+/* Remove the file at path, if it exists, on the background I/O
+ * thread. */
+void bgremove(const char *path);
+/* The jobs queued between bgbegin and bgend are a group: if one
+ * fails then the rest of the group are dropped.  bgend waits for the
+ * group and returns false, with the error string set, if it failed. */
+void bgbegin(void);
+_Bool bgend(void);
+/* Wait for all queued background writes to finish.  Returns false,
+ * with the error string set, if any of them failed since the last
+ * call. */
+_Bool bgsync(void);
+
 typedef struct Msg {
 	const char *txt;
 	int left;
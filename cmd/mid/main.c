@@ -10,6 +10,7 @@
 Gfx *gfx;
 
 static void usage(int);
+static void prstats(const char *, Rtab *);
 
 bool init()
 {
@@ -56,6 +57,10 @@ bool init()
 
 void deinit()
 {
+	prstats("imgs", imgs);
+	prstats("txt", txt);
+	prstats("music", music);
+	prstats("sfx", sfx);
 	freeresrc();
 	sndfree();
 	gfxfree(gfx);
@@ -65,6 +70,8 @@ void deinit()
 int main(int argc, char *argv[])
 {
 	char *kmname = NULL;
+	long budget = -1;
+	bool watch = false;
 
 #	define ARGIS(a) argv[i][0] == '-' && argv[i][1] == a && argv[i][2] == 0
 
@@ -78,16 +85,35 @@ int main(int argc, char *argv[])
 				usage(1);
 			kmname = argv[i+1];
 			i++;
+		}else if(ARGIS('b')){
+			if(i + 1 == argc)
+				usage(1);
+			budget = strtol(argv[i+1], NULL, 10);
+			if(budget <= 0)
+				usage(1);
+			i++;
 		}else if(ARGIS('m')){
 			mute = 1;
 		}else if (ARGIS('p')){
 			zonestdin();
+		}else if (ARGIS('w')){
+			watch = true;
 		}
 	}
 
 	if (!init())
 		fatal("Failed to initialize: %s", miderrstr());
 
+	if(budget > 0){
+		unsigned long b = (unsigned long)budget << 20;
+		rtabbudget(imgs, b);
+		rtabbudget(txt, b);
+		rtabbudget(music, b);
+		rtabbudget(sfx, b);
+	}
+	if(watch && !resrcwatch())
+		pr("Not watching resources: %s", miderrstr());
+
 	if(kmname){
 		if (!keymapread(kmap, kmname))
 			die("failed to read %s", kmname);
@@ -104,18 +130,34 @@ int main(int argc, char *argv[])
 	scrnrun(stk);
 	pr("Mean frame time: %g ms", meanftime);
 	scrnstkfree(stk);
+	_Bool saved = bgsync();
+	if (!saved)
+		pr("Failed to save the game: %s", miderrstr());
 
 	deinit();
-	return 0;
+	return saved ? 0 : 1;
 }
 
 static void usage(int s)
 {
-	puts("Usage: mid [-d] [-h] [-k <file>] [-m] [-p]");
+	puts("Usage: mid [-b <MiB>] [-d] [-h] [-k <file>] [-m] [-p] [-w]");
+	puts("-b <MiB>	limit the memory that each resource table keeps\n\tfor resources no longer in use, such as those\n\treleased by closed screens; the images packed\n\tinto the atlas always stay loaded and don't count");
 	puts("-d	enable debugging");
 	puts("-h	print usage information");
 	puts("-k <file>	specify the key map file");
 	puts("-m	mute the sound effects");
 	puts("-p	accept the pipeline from standard input");
+	puts("-w	reload resources when their files change");
 	exit(s);
-}
\ No newline at end of file
+}
+
+static void prstats(const char *name, Rtab *t)
+{
+	Rtabstats st = rtabstats(t);
+	pr("%s: %lu hits, %lu misses, %lu loads, %lu evictions, "
+		"%lu reloads, %d resident (%lu bytes), %d cached (%lu bytes), "
+		"%lu bytes pinned, budget %lu bytes for the rest", name,
+		st.hits, st.misses, st.loads, st.evictions, st.reloads,
+		st.nresident, st.resident, st.ncached, st.cached, st.pinned,
+		st.budget);
+}
@@ -257,5 +257,9 @@ static void optsfree(Scrn *s){
 		sndvol(opt->origvol);
 	}
 
+	Txtinfo ti = { TxtSzMedium };
+	resrcrel(txt, TxtStyleMenu, &ti);
+	resrcrel(sfx, "sfx/ow.wav", 0);
+
 	memset(opt, 0, sizeof(*opt));
 }
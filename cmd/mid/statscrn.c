@@ -156,6 +156,8 @@ static void statupfree(Scrn *s){
 	Statup *sup = s->data;
 	if(sup->uorbs > 0)
 		sup->shrine->id = EnvShrused;
+	Txtinfo ti = { TxtSzMedium };
+	resrcrel(txt, TxtStyleMenu, &ti);
 	*sup = (Statup){0};
 }
 
@@ -47,6 +47,7 @@ Scrn *titlescrnnew(Gfx *g){
 		return NULL;
 
 	t.copy = txt2img(g, f, "Copyright 2011 Steve McCoy and Ethan Burns");
+	resrcrel(txt, TxtStyleMenu, &ti);
 	if(!t.copy)
 		return NULL;
 
@@ -126,4 +127,7 @@ static void handle(Scrn *s, Scrnstk *stk, Event *e){
 static void titfree(Scrn *s){
 	Tit *t = s->data;
 	imgfree(t->copy);
+	resrcrel(imgs, "img/title.png", 0);
+	Txtinfo ti = { TxtSzMedium };
+	resrcrel(txt, TxtStyleMenu, &ti);
 }
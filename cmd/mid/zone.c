@@ -2,6 +2,7 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -24,6 +25,24 @@ typedef struct Pipe {
 
 static FILE *inzone = NULL;
 
+/* The last few zones are kept in memory and only written to their
+ * files, by the background I/O thread, when they are evicted, so
+ * going back and forth on the stairs doesn't touch the disk. */
+enum { Ncached = 4 };
+
+typedef struct Zcache {
+	Zone *zn;
+	int znum;
+	_Bool dirty;
+	unsigned long used;
+} Zcache;
+
+static Zcache cache[Ncached];
+static unsigned long usetick;
+
+static Zcache *cachefind(int);
+static Zcache *cacheslot(void);
+static void zonewritefile(Zone *, int);
 static char *zonefile(int);
 static FILE *zpipe(Rng *r);
 static void pipeadd(struct Pipe *, char *, char *, ...);
@@ -63,7 +82,15 @@ Zone *zonegen(Rng *r)
 
 Zone *zoneget(int znum)
 {
+	Zcache *c = cachefind(znum);
+	if (c) {
+		c->used = ++usetick;
+		return c->zn;
+	}
+
 	ignframetime();
+	if (!bgsync())
+		die("Failed to write back a zone: %s", miderrstr());
 
 	char *zfile = zonefile(znum);
 	FILE *f = fopen(zfile, "r");
@@ -75,22 +102,32 @@ Zone *zoneget(int znum)
 		die("Failed to read the zone file [%s]: %s", zfile, miderrstr());
 
 	fclose(f);
+
+	c = cacheslot();
+	*c = (Zcache){ zn, znum, false, ++usetick };
 	return zn;
 }
 
 void zoneput(Zone *zn, int znum)
 {
-	ignframetime();
-	if (!ensuredir(zonedir))
-		die("Failed to make zone directory: %s", miderrstr());
-	
-	char *zfile = zonefile(znum);
-	FILE *f = fopen(zfile, "w");
-	if (!f)
-		die("Failed to open zone file for writing [%s]: %s", zfile, miderrstr());
+	Zcache *c = cachefind(znum);
+	if (c && c->zn != zn)
+		zonefree(c->zn);
+	if (!c)
+		c = cacheslot();
+	*c = (Zcache){ zn, znum, true, ++usetick };
+}
 
-	zonewrite(f, zn);
-	fclose(f);
+void zonesave(int znum, const char *path)
+{
+	Zcache *c = cachefind(znum);
+	if (!c) {
+		bgcopy(path, zonefile(znum));
+		return;
+	}
+	Buf b = {};
+	zoneprint(&b, c->zn);
+	bgwrite(path, b);
 }
 
 Tileinfo zonedstairs(Zone *zn)
@@ -111,6 +148,14 @@ Tileinfo zonedstairs(Zone *zn)
 
 void zonecleanup(int zmax)
 {
+	if (!bgsync())
+		pr("Failed to write back a zone: %s", miderrstr());
+	for (int i = 0; i < Ncached; i++) {
+		if (cache[i].zn)
+			zonefree(cache[i].zn);
+		cache[i] = (Zcache){};
+	}
+
 	for (int i = 0; i <= zmax; i++) {
 		char *zfile = zonefile(i);
 		if (!fsexists(zfile))
@@ -120,6 +165,44 @@ void zonecleanup(int zmax)
 	}
 }
 
+static Zcache *cachefind(int znum)
+{
+	for (int i = 0; i < Ncached; i++) {
+		if (cache[i].zn && cache[i].znum == znum)
+			return &cache[i];
+	}
+	return NULL;
+}
+
+/* Returns an empty cache entry, evicting the least recently used
+ * zone and writing it back to its file if it has changed. */
+static Zcache *cacheslot(void)
+{
+	Zcache *lru = &cache[0];
+	for (int i = 0; i < Ncached; i++) {
+		if (!cache[i].zn)
+			return &cache[i];
+		if (cache[i].used < lru->used)
+			lru = &cache[i];
+	}
+
+	if (lru->dirty)
+		zonewritefile(lru->zn, lru->znum);
+	zonefree(lru->zn);
+	*lru = (Zcache){};
+	return lru;
+}
+
+static void zonewritefile(Zone *zn, int znum)
+{
+	if (!ensuredir(zonedir))
+		die("Failed to make zone directory: %s", miderrstr());
+
+	Buf b = {};
+	zoneprint(&b, zn);
+	bgwrite(zonefile(znum), b);
+}
+
 // Non re-entrant
 static char *zonefile(int znum)
 {
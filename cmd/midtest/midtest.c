@@ -0,0 +1,86 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+/* Tests of mid's game logic that don't need a window.  Run it from
+ * the top of the tree, as mid is, so that zones can be generated. */
+
+#include "../mid/game.c"
+
+static int nfail;
+
+static void check(_Bool ok, const char *what)
+{
+	if (!ok) {
+		pr("FAIL: %s", what);
+		nfail++;
+	}
+}
+
+/* Going down and back up the stairs should leave the player in the
+ * zone that they came back to, not bounce them back down. */
+static void teststairs(void)
+{
+	static Game gm;
+	gm = (Game){};
+	rnginit(&gm.rng, 1);
+	gm.zone = zonegen(&gm.rng);
+	zoneput(gm.zone, 0);
+
+	gm.zone->updown = Godown;
+	trystairs(NULL, &gm);
+	check(gm.znum == 1, "went down to zone 1");
+
+	gm.zone->updown = Goup;
+	trystairs(NULL, &gm);
+	check(gm.znum == 0, "came back up to zone 0");
+	check(gm.zone->updown == Gonone, "zone 0 is off the stairs");
+
+	trystairs(NULL, &gm);
+	check(gm.znum == 0, "stayed in zone 0");
+
+	gm.zone->updown = Godown;
+	trystairs(NULL, &gm);
+	check(gm.znum == 1, "went down to zone 1 again");
+	check(gm.zone->updown == Gonone, "zone 1 is off the stairs");
+
+	zonecleanup(gm.zmax);
+}
+
+/* A failed save should drop the rest of the save, but not a zone
+ * written back after it, and should only be reported by bgend. */
+static void testbgfail(void)
+{
+	Buf b = {};
+	bgbegin();
+	bufput(&b, "x", 1);
+	bgwrite("_testzones/missing/0.zone", b);
+	b = (Buf){};
+	bufput(&b, "x", 1);
+	bgwrite("_testzones/game", b);
+	check(!bgend(), "the save failed");
+
+	b = (Buf){};
+	bufput(&b, "x", 1);
+	bgwrite("_testzones/0.zone", b);
+	check(bgsync(), "the write-back is unaffected");
+	check(!fsexists("_testzones/game"), "the rest of the save was dropped");
+	check(fsexists("_testzones/0.zone"), "the write-back was written");
+	remove("_testzones/0.zone");
+}
+
+int main(int argc, char *argv[])
+{
+	loginit(NULL);
+	zoneloc("_testzones");
+	if (!ensuredir("_testzones"))
+		die("Failed to make the zone directory: %s", miderrstr());
+
+	teststairs();
+	testbgfail();
+
+	remove("_testzones/cur.lvl");
+	remove("_testzones");
+	if (nfail > 0)
+		die("%d checks failed", nfail);
+	pr("ok");
+	return 0;
+}
@@ -0,0 +1,205 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+/* Visbench reads a level from standard input and compares lvlvis
+ * against the Bresenham visibility rays that it replaced.  Each
+ * algorithm is run from every stride'th open block on every layer,
+ * and for each the average time and number of blocks seen is
+ * reported, along with the blocks seen by one but not the other. */
+
+#include "../../include/mid.h"
+#include "../../include/log.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+enum { Defstride = 7 };
+
+typedef struct Stats Stats;
+struct Stats {
+	double secs;
+	long seen;
+};
+
+static void rayvis(Lvl *, int, int);
+static void visline(Lvl *, int, int, int, int);
+static _Bool edge(Lvl *, int, int);
+static _Bool blkd(Lvl *, int, int);
+static void clearvis(Lvl *);
+static void run(Lvl *, int, int, int, _Bool, Stats *, char *);
+static long count(Lvl *);
+static char *readin(void);
+
+int main(int argc, char *argv[])
+{
+	int r = 0, stride = Defstride;
+
+	loginit(NULL);
+
+	if (argc > 3)
+		fatal("usage: visbench [<radius> [<stride>]]");
+	if (argc > 1)
+		r = strtol(argv[1], NULL, 10);
+	if (argc > 2)
+		stride = strtol(argv[2], NULL, 10);
+	if (r < 0 || stride <= 0)
+		fatal("Invalid radius or stride");
+
+	char *buf = readin();
+	char *p = buf;
+	Lvl *l = lvlscan(&p);
+	if (!l)
+		die("Failed to scan the level: %s", miderrstr());
+
+	int n = l->w * l->h;
+	char *rays = xalloc(n, 1);
+	char *fov = xalloc(n, 1);
+	Stats rs = {0}, fs = {0};
+	long samples = 0, onlyrays = 0, onlyfov = 0;
+
+	for (l->z = 0; l->z < l->d; l->z++) {
+		for (int i = 0; i < n; i += stride) {
+			int x = i % l->w, y = i / l->w;
+			if (blkd(l, x, y))
+				continue;
+			run(l, x, y, r, true, &rs, rays);
+			run(l, x, y, r, false, &fs, fov);
+			for (int j = 0; j < n; j++) {
+				onlyrays += rays[j] && !fov[j];
+				onlyfov += fov[j] && !rays[j];
+			}
+			samples++;
+		}
+	}
+	if (samples == 0)
+		die("No open blocks in the level");
+
+	printf("%ld views of a %dx%dx%d level", samples, l->w, l->h, l->d);
+	if (r > 0)
+		printf(", radius %d", r);
+	printf("\n%-8s %10s %10s %10s\n", "", "us/view", "seen/view", "only/view");
+	printf("%-8s %10.2f %10.1f %10.2f\n", "rays", rs.secs * 1e6 / samples,
+		(double) rs.seen / samples, (double) onlyrays / samples);
+	printf("%-8s %10.2f %10.1f %10.2f\n", "lvlvis", fs.secs * 1e6 / samples,
+		(double) fs.seen / samples, (double) onlyfov / samples);
+
+	xfree(rays);
+	xfree(fov);
+	lvlfree(l);
+	xfree(buf);
+	return 0;
+}
+
+/* Run one algorithm from (x, y) on a clean level, adding its time and
+ * coverage to st and recording the seen blocks of the layer in vis. */
+static void run(Lvl *l, int x, int y, int r, _Bool useray, Stats *st, char *vis)
+{
+	clearvis(l);
+	clock_t start = clock();
+	if (useray)
+		rayvis(l, x, y);
+	else
+		lvlvis(l, x, y, r);
+	st->secs += (double) (clock() - start) / CLOCKS_PER_SEC;
+	st->seen += count(l);
+
+	Blk *b = l->blks + l->z * l->w * l->h;
+	for (int i = 0; i < l->w * l->h; i++)
+		vis[i] = (b[i].flags & Blkvis) != 0;
+}
+
+static void clearvis(Lvl *l)
+{
+	for (int i = 0; i < l->w * l->h * l->d; i++)
+		l->blks[i].flags &= ~Blkvis;
+}
+
+static long count(Lvl *l)
+{
+	long n = 0;
+	for (int i = 0; i < l->w * l->h * l->d; i++)
+		n += (l->blks[i].flags & Blkvis) != 0;
+	return n;
+}
+
+/* The visibility algorithm before shadowcasting: rasterize a
+ * Bresenham line from (x, y) to each block on the border of the
+ * level, stopping at the first opaque block.  It ignores the radius. */
+static void rayvis(Lvl *l, int x, int y)
+{
+	for (int i = 0; i < l->w; i++) {
+		visline(l, x, y, i, 0);
+		visline(l, x, y, i, l->h - 1);
+	}
+	for (int i = 0; i < l->h; i++) {
+		visline(l, x, y, 0, i);
+		visline(l, x, y, l->w - 1, i);
+	}
+}
+
+static void swap(int *a, int *b)
+{
+	int t = *a;
+	*a = *b;
+	*b = t;
+}
+
+static void visline(Lvl *l, int x0, int y0, int x1, int y1)
+{
+	_Bool steep = abs(y1 - y0) > abs(x1 - x0);
+	if (steep) {
+		swap(&x0, &y0);
+		swap(&x1, &y1);
+	}
+	int dx = abs(x1 - x0);
+	int dy = abs(y1 - y0);
+	double err = 0.0;
+	double derr = (double)dy / (double)dx;
+	int ystep = y0 < y1 ? 1 : -1;
+	int y = y0;
+	int xstep = x0 < x1 ? 1 : -1;
+	for (int x = x0; ; x += xstep) {
+		int px = steep ? y : x;
+		int py = steep ? x : y;
+		blk(l, px, py, l->z)->flags |= Blkvis;
+		if (blkd(l, px, py) || x == x1)
+			break;
+		err += derr;
+		if (err >= 0.5) {
+			int x1 = steep ? y + ystep : x + xstep;
+			int y1 = steep ? x + xstep : y + ystep;
+			if (blkd(l, px, y1) && blkd(l, x1, py)) {
+				if (edge(l, x1, y1))
+					blk(l, x1, y1, l->z)->flags |= Blkvis;
+				break;
+			}
+			y += ystep;
+			err -= 1.0;
+		}
+	}
+}
+
+static _Bool edge(Lvl *l, int x, int y)
+{
+	return x <= 0 || y <= 0 || x >= l->w - 1 || y >= l->h - 1;
+}
+
+static _Bool blkd(Lvl *l, int x, int y)
+{
+	return lvlhas(l, x, y, l->z, Popaque);
+}
+
+static char *readin(void)
+{
+	size_t n = 0, sz = 4096;
+	char *buf = xalloc(sz, 1);
+
+	while ((n += fread(buf + n, 1, sz - n - 1, stdin)) == sz - 1) {
+		sz *= 2;
+		buf = xrealloc(buf, sz);
+	}
+	if (ferror(stdin))
+		die("Failed to read the level");
+
+	buf[n] = '\0';
+	return buf;
+}
@@ -0,0 +1,64 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+/* Zonebench reads a zone file from standard input and reports how
+ * long it takes to scan it with zonescan. */
+
+#include "../../include/mid.h"
+#include "../../include/log.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+
+enum { Defiters = 1000 };
+
+static char *readin(size_t *);
+
+int main(int argc, char *argv[])
+{
+	long iters = Defiters;
+
+	loginit(NULL);
+
+	if (argc > 2)
+		fatal("usage: zonebench [<iterations>]");
+	if (argc == 2)
+		iters = strtol(argv[1], NULL, 10);
+	if (iters <= 0 || iters == LONG_MAX)
+		fatal("Invalid number of iterations: %s", argv[1]);
+
+	size_t n;
+	char *buf = readin(&n);
+
+	clock_t start = clock();
+	for (long i = 0; i < iters; i++) {
+		Zone *zn = zonescan(buf);
+		if (!zn)
+			die("Failed to scan the zone: %s", miderrstr());
+		zonefree(zn);
+	}
+	double secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	printf("%ld scans of %lu bytes\n", iters, (unsigned long) n);
+	printf("%g ms/scan\n", secs * 1000 / iters);
+	printf("%g MB/s\n", n * iters / secs / (1024 * 1024));
+
+	xfree(buf);
+	return 0;
+}
+
+static char *readin(size_t *np)
+{
+	size_t n = 0, sz = 4096;
+	char *buf = xalloc(sz, 1);
+
+	while ((n += fread(buf + n, 1, sz - n - 1, stdin)) == sz - 1) {
+		sz *= 2;
+		buf = xrealloc(buf, sz);
+	}
+	if (ferror(stdin))
+		die("Failed to read the zone");
+
+	buf[n] = '\0';
+	*np = n;
+	return buf;
+}
@@ -4,15 +4,32 @@
 
 // Mean frame time
 extern double meanftime;
-// Ignore the time for this frame in the mean computation.
+// Ignore the time for this frame in the mean computation, and don't
+// run extra ticks to catch up with it.
 void ignframetime(void);
+// How far the frame being drawn is from the previous tick, 0, to the
+// latest one, 1.
+extern double tickalpha;
+// The number of ticks run so far, which animations are drawn from.
+extern unsigned long curtick;
 
 extern int debugging;
 extern _Bool mute;
 
 void *xalloc(unsigned long n, unsigned long sz);
+void *xrealloc(void *, unsigned long sz);
 void xfree(void*);
 
+/* A growable byte buffer.  A zero Buf is empty, and b is xalloc'd. */
+typedef struct Buf Buf;
+struct Buf {
+	char *b;
+	int n, sz;
+};
+
+void bufput(Buf *, const char *, int n);
+void bufprintf(Buf *, const char *fmt, ...);
+
 const char *miderrstr(void);
 void seterrstr(const char *fmt, ...);
 
@@ -78,20 +95,72 @@ typedef struct Gfx Gfx;
 Gfx *gfxinit(int w, int h, const char *title);
 void gfxfree(Gfx *);
 Point gfxdims(const Gfx *);
+/* Runs fn(arg) on a new thread, returning its result.  Meanwhile the
+ * calling thread owns the window: it pumps events and presents each
+ * frame that fn flips while fn goes on to the next one. */
+int gfxrun(Gfx *, int (*fn)(void *), void *arg);
 void gfxflip(Gfx *);
 void gfxclear(Gfx *, Color);
 void gfxdrawpoint(Gfx *, Point, Color);
 void gfxfillrect(Gfx *, Rect, Color);
+/* Fills n rectangles of the same color with one draw. */
+void gfxfillrects(Gfx *, Rect *, int n, Color);
 void gfxdrawrect(Gfx *, Rect, Color);
 
 typedef struct Img Img;
 
 Img *imgnew(const char *path);
+
+/* Decoded image pixels that haven't been made into an Img.  Unlike
+ * the other image functions, imgdecode and imgdatafree may be called
+ * from any thread. */
+typedef struct Imgdata Imgdata;
+
+/* Returns NULL on failure. */
+Imgdata *imgdecode(const char *path);
+void imgdatafree(Imgdata *);
+/* Makes an Img from decoded pixels, freeing them.  Returns NULL on
+ * failure, or if the Imgdata is NULL. */
+Img *imgupload(Imgdata *);
+/* Makes Imgs from decoded pixels, freeing them, packing them into a
+ * shared texture so that they can be drawn in the same batch.  Images
+ * that don't fit are given textures of their own.  The return value
+ * is false if any image failed to upload. */
+_Bool imgatlas(Img *imgs[], Imgdata *data[], int n);
 void imgfree(Img *);
+/* Replaces the image with the one in the file at path, leaving it
+ * unchanged on failure. */
+_Bool imgreload(Img *, const char *path);
+/* Returns a new, transparent w×h image that can be drawn on with
+ * gfxtarget, or NULL if the renderer can't draw to images. */
+Img *imgtarget(Gfx *, int w, int h);
+/* Returns a new w×h image whose pixels are set with imgsetpx.  Each
+ * pixel is drawn as a solid block when the image is scaled, with no
+ * filtering.  Returns NULL on failure. */
+Img *imgstream(Gfx *, int w, int h);
+/* Sets the pixels of an image from imgstream, row by row. */
+void imgsetpx(Img *, const Color *px);
+/* Sets n rows of an image from imgstream, starting at row y, leaving
+ * the rest as they were. */
+void imgsetrows(Img *, int y, int n, const Color *px);
+/* Direct drawing to an image from imgtarget, or to the window if the
+ * image is NULL. */
+void gfxtarget(Gfx *, Img *);
+/* Returns a count that changes whenever the renderer loses what was
+ * drawn on the images from imgtarget, which must then be redrawn. */
+unsigned long gfxresets(Gfx *);
 /* Returns negative dimensions on failure. */
 Point imgdims(const Img *);
+/* Returns the approximate texture memory used by the image.  An image
+ * in an atlas counts only its own region. */
+unsigned long imgbytes(const Img *);
 void imgdraw(Gfx *, Img *, Point);
+/* Draws the image over what is under it, including its alpha, rather
+ * than blending with it. */
+void imgcopy(Gfx *, Img *, Point);
 void imgdrawreg(Gfx *, Img *, Rect, Point);
+/* Draws the whole image stretched to fill the rectangle. */
+void imgdrawscaled(Gfx *, Img *, Rect);
 
 typedef struct Txt Txt;
 
@@ -105,6 +174,9 @@ enum{
 
 Txt *txtnew(const char *font, int sz, Color);
 void txtfree(Txt *);
+_Bool txtreload(Txt *, const char *font, int sz);
+/* Returns an estimate of the font's memory use. */
+unsigned long txtbytes(const Txt *);
 Point txtdims(const Txt *, const char *fmt, ...);
 Img *txt2img(Gfx *, Txt *, const char *fmt, ...);
 // Prefer txt2img to this for static text
@@ -117,8 +189,10 @@ void cammove(Gfx *, double dx, double dy);
 Point camget(Gfx*);
 void camdrawrect(Gfx *, Rect, Color);
 void camfillrect(Gfx *, Rect, Color);
+void camfillrects(Gfx *, Rect *, int n, Color);
 void camdrawimg(Gfx *, Img *, Point);
 void camdrawreg(Gfx *, Img *, Rect, Point);
+void camdrawscaled(Gfx *, Img *, Rect);
 void camdrawanim(Gfx *, Anim *, Point);
 
 _Bool sndinit(void);
@@ -146,6 +220,8 @@ typedef struct Sfx Sfx;
 
 Sfx *sfxnew(const char *);
 void sfxfree(Sfx *);
+_Bool sfxreload(Sfx *, const char *path);
+unsigned long sfxbytes(const Sfx *);
 void sfxplay(Sfx *);
 
 enum Eventty{
@@ -211,13 +287,40 @@ typedef struct Resrcops Resrcops;
 struct Resrcops {
 	void*(*load)(const char *path, void *aux);
 	void(*unload)(const char *path, void *resrc, void *aux); /* may be NULL */
-	unsigned int (*hash)(const char *path, void *aux); /* may be NULL */
-	_Bool (*eq)(void *aux0, void *aux1); /* may be NULL */
+	/* hash and eq are for the aux data, the file is compared
+	 * separately.  Both may be NULL if aux isn't part of the key. */
+	unsigned int (*hash)(void *aux);
+	_Bool (*eq)(void *aux0, void *aux1);
+	/* Returns the bytes of memory used by a loaded resource.  May
+	 * be NULL, in which case resources are counted as 0 bytes. */
+	unsigned long (*bytes)(void *resrc, void *aux);
+	/* Reloads a resource in place from its changed file, so that
+	 * references to it stay valid.  May be NULL. */
+	_Bool (*reload)(const char *path, void *resrc, void *aux);
+};
+
+typedef struct Rtabstats Rtabstats;
+struct Rtabstats {
+	unsigned long hits, misses, loads, evictions;
+	unsigned long reloads;	/* resources replaced in place by resrcpoll */
+	unsigned long budget;
+	/* Resident counts include the unreferenced resources that are
+	 * still cached, and the pinned images in the atlas. */
+	unsigned long resident, cached, pinned;		/* bytes */
+	int nresident, ncached;
 };
 
 Rtab *rtabnew(Resrcops *);
 /* unloads all resources and frees the table. */
 void rtabfree(Rtab *);
+/* Sets the number of bytes that the table may hold before it unloads
+ * unreferenced resources, least recently used first.  Pinned images,
+ * those in the atlas, are never unloaded and don't count. */
+void rtabbudget(Rtab *, unsigned long bytes);
+/* Sets a function to call with each resource that resrcpoll reloads,
+ * replacing any earlier one. */
+void rtabonreload(Rtab *, void (*)(void *resrc));
+Rtabstats rtabstats(Rtab *);
 /* Acquire a reference to a resource (loading it if necessary).  The
  * 3rd param is passed as aux data as the 2nd param of load. */
 void *resrcacq(Rtab *, const char *file, void *aux);
@@ -236,17 +339,27 @@ extern Rtab *music;
 extern Rtab *sfx;
 void initresrc(void);
 void freeresrc(void);
-
+/* Starts watching the resource directories, so that resrcpoll reloads
+ * resources whose files change. */
+_Bool resrcwatch(void);
+void resrcpoll(void);
+
+/* An animation's frame is a function of the tick alone, so there is
+ * nothing to update and it can be drawn at any time.  Frame 0 is
+ * shown from tick start, and each frame for delay ticks. */
 struct Anim{
 	Img *sheet;
 	int row, len;
 	int delay;
 	int w, h;
-	int f, d;
+	unsigned long start;
 };
 
-void animupdate(Anim *);
+/* Returns the frame shown at the given tick. */
+int animframe(const Anim *, unsigned long tick);
+/* Draws the frame for curtick. */
 void animdraw(Gfx *, Anim *, Point);
+/* Restarts the animation from frame 0 at curtick. */
 void animreset(Anim *a);
 
 typedef struct Blk Blk;
@@ -255,25 +368,62 @@ struct Blk {
 	char flags;
 };
 
+/* Blk flags. */
+enum { Blkvis = 1 << 1 };
+
 typedef struct Lvl Lvl;
 struct Lvl {
 	int d, w, h, z;
 	int seenz;
+	/* The visibility of layer maskz, one pixel per block, drawn
+	 * over the level by lvldraw.  Rows masky0 up to masky1 are
+	 * out of date and are rebuilt before it is next drawn. */
+	Img *mask;
+	int maskz;
+	int masky0, masky1;
+	/* Bitplane p holds, for each layer, a bit per block that is
+	 * set if the block's tile has flag 1<<p.  Each layer is
+	 * pwords words of 64 blocks, in the order of blks. */
+	unsigned long long *planes;
+	int pwords;
 	Blk blks[];
 };
 
 Lvl *lvlnew(int, int, int, int);
-Lvl *lvlread(FILE *);
+/* Sets the tile of a block, updating the bitplanes.  Tiles must only
+ * be changed with lvlsettile. */
+void lvlsettile(Lvl *, int x, int y, int z, int tile);
+/* Scan a level from the string at *bufp, leaving *bufp pointing just
+ * past the level's last row. */
+Lvl *lvlscan(char **bufp);
 void lvlwrite(FILE *, Lvl *);
+/* Append the level, as written by lvlwrite, to the buffer. */
+void lvlprint(Buf *, Lvl *);
 void lvlfree(Lvl *);
 _Bool lvlinit();
-void lvlupdate(Lvl *l);
 void lvldraw(Gfx *g, Lvl *l, _Bool bkgrnd);
 void lvlminidraw(Gfx *g, Lvl *l, Point offs, int scale);
 /* Returns the reverse vector that must be added to v in order to
  * respect collisions. */
 Isect lvlisect(Lvl *l, Rect r, Point v);
 
+enum { Maxsweep = 32 };
+
+/* The colliding tiles that a body's path for one tick passes through,
+ * gathered in one pass over the level by lvlsweep.  For each step of
+ * at most a pixel along the path, sweepisect(s, r, v) returns the same
+ * as lvlisect(s->lvl, r, v), usually without looking at the level. */
+typedef struct Sweep Sweep;
+struct Sweep {
+	Lvl *lvl;
+	Rect box;	/* bounds of the path */
+	int n;
+	Rect tiles[Maxsweep];	/* bounding boxes */
+};
+
+void lvlsweep(Lvl *l, Rect r, Point v, Sweep *s);
+Isect sweepisect(Sweep *s, Rect r, Point v);
+
 enum{
 	LvlMaxPallets = 2
 };
@@ -286,14 +436,26 @@ struct Tileinfo {
 	unsigned int flags;
 };
 
+/* Tile flags, each also kept by the level as a bitplane. */
+enum {
+	Pcollide,
+	Pwater,
+	Pfdoor,
+	Pbdoor,
+	Pdown,
+	Pup,
+	Popaque,
+	Nplanes,
+};
+
 enum {
-	Tcollide = 1<<0,
-	Twater = 1<<1,
-	Tfdoor = 1<<2,
-	Tbdoor = 1<<3,
-	Tdown = 1 << 4,
-	Tup = 1 << 5,
-	Topaque = 1 << 6,
+	Tcollide = 1 << Pcollide,
+	Twater = 1 << Pwater,
+	Tfdoor = 1 << Pfdoor,
+	Tbdoor = 1 << Pbdoor,
+	Tdown = 1 << Pdown,
+	Tup = 1 << Pup,
+	Topaque = 1 << Popaque,
 };
 
 enum { Theight = 32, Twidth = 32 };
@@ -307,13 +469,63 @@ static inline Blk *blk(Lvl *l, int x, int y, int z)
 	return &l->blks[z * l->w * l->h + y * l->w + x];
 }
 
+/* Returns whether the tile at x, y, z has flag 1<<p. */
+static inline _Bool lvlhas(Lvl *l, int x, int y, int z, int p)
+{
+	unsigned int i = y * l->w + x;
+	return l->planes[(p * l->d + z) * l->pwords + i / 64] >> (i % 64) & 1;
+}
+
 
 double blkgrav(int flags);
 double blkdrag(int flags);
 
 /* Update the visibility of the level given that the player is viewing
- * the level from location (x, y). */
-void lvlvis(Lvl *l, int x, int y);
+ * the level from location (x, y).  Only blocks within r blocks are
+ * seen, unless r is 0. */
+void lvlvis(Lvl *l, int x, int y, int r);
+
+/* A graph of where a body can stand on one layer of a level and the
+ * walks, jumps and falls between those blocks. */
+typedef struct Nav Nav;
+
+Nav *navnew(Lvl *l, int z);
+void navfree(Nav *);
+/* Returns the node a body at block (x, y) stands on, or will land on
+ * if it is in the air, or -1 if there is none. */
+int navnode(Nav *, int x, int y);
+
+enum { Maxpath = 16 };
+
+/* The start of a path to the goal node, kept between calls to navnext
+ * so that it is only searched for again when the goal moves or the
+ * body strays from it.  A zeroed Navpath is empty. */
+typedef struct Navpath Navpath;
+struct Navpath {
+	int goal, at;
+	// The number of nodes after at, stored nearest last, or -1 if
+	// there is no path.
+	int n;
+	int nodes[Maxpath];
+};
+
+/* Set (*nx, *ny) to the next block on the way from block (x, y) to
+ * block (gx, gy), returning false if there is no way there or the
+ * body is already there. */
+_Bool navnext(Nav *, Navpath *, int x, int y, int gx, int gy, int *nx, int *ny);
+/* Start a tick.  Once the searches of navnext have closed a few
+ * thousand nodes in a tick, it only follows the paths it already has
+ * until the next call. */
+void navtick(Nav *);
+
+/* Find, for every node within a few dozen moves of block (x, y), its
+ * next move toward (x, y).  Nothing is done if (x, y) is on the same
+ * node as the last call, so it is cheap to call every tick. */
+void navflow(Nav *, int x, int y);
+/* Set (*nx, *ny) to the next block from block (x, y) toward the block
+ * given to the last navflow, returning false if (x, y) is already
+ * there or too far away. */
+_Bool navstep(Nav *, int x, int y, int *nx, int *ny);
 
 typedef enum Action Action;
 enum Action{
@@ -346,10 +558,27 @@ struct Body {
 	Point vel;
 	Point acc;
 	_Bool fall;
+	Point prev;	/* bbox.a at the start of the latest tick */
 };
 
 void bodyinit(Body *, int x, int y, int w, int h);
+/* Records the body's location at the start of a tick. */
+void bodystart(Body *);
+/* Moves the body for a tick with bodyupdatedbl, or with bodyupdatefix
+ * if built with -DFIXPHYS. */
 void bodyupdate(Body *b, Lvl *l);
+/* Moves the body using doubles. */
+void bodyupdatedbl(Body *b, Lvl *l);
+/* Moves the body using 24.8 fixed point.  The body's bbox, vel and
+ * acc are rounded to 1/256 and the results are exact in a double, so
+ * the simulation is the same for any compiler and optimization level.
+ * Starting on the 1/256 grid, it matches bodyupdatedbl. */
+void bodyupdatefix(Body *b, Lvl *l);
+/* Returns where to draw the body's bbox.a this frame. */
+Point bodydrawpt(const Body *);
+/* Interpolates from prev to cur by tickalpha, or returns cur if it is
+ * too far from prev to have been reached in a tick. */
+Point ticklerp(Point prev, Point cur);
 
 typedef struct Sword Sword;
 typedef enum Act Act;
@@ -433,8 +662,9 @@ struct Item{
 
 _Bool itemldresrc(void);
 _Bool iteminit(Item*, ItemID id, Point p);
-void itemupdateanims(void);
 void itemupdate(Item*, Player*, Zone *z);
+/* Called when the player touches the item. */
+void itempickup(Item*, Player*, Zone *z);
 void itemdraw(Item*, Gfx*);
 char *itemname(ItemID);
 EqpLoc itemeqploc(ItemID);
@@ -470,6 +700,9 @@ ArmorSetID itemarmorset(ItemID);
 void applyarmorbonus(Player*, ArmorSetID);
 Img *armorsetsheet(ArmorSetID, ArmorLoc);
 Img *armorinvsheet(ArmorSetID);
+/* Returns a count that changes whenever one of the armor's images is
+ * reloaded. */
+unsigned long armorreloads(void);
 
 typedef enum Dir {
 	Left,
@@ -482,6 +715,7 @@ struct Player {
 	Dir dir;
 	Act act;
 	Point imgloc;
+	Point previmgloc;	/* imgloc at the start of the latest tick */
 
 	Body body;
 
@@ -506,9 +740,20 @@ struct Player {
 	Invit wear[EqpMax];
 
 	Sword sw;
+
+	/* The armor layers composited by playerdraw into one sheet.
+	 * It is redrawn if armdirty is set, by resetstats when the
+	 * equipment changes, or if the gfxresets or armorreloads count
+	 * that it was drawn at has changed. */
+	Img *armcomp;
+	_Bool armdirty;
+	unsigned long armresets, armreloads;
+	_Bool armfailed;	/* the renderer can't draw to images */
 };
 
 void playerinit(Player *p, int x, int y);
+/* Frees the images made by playerdraw. */
+void playerfree(Player *p);
 void playersetloc(Player *p, int x, int y);	// tile coords
 void playerupdate(Player *, Zone *, Point *tr);
 void playerdraw(Gfx *, Player *);
@@ -539,6 +784,9 @@ struct Ai{
 	Point mv;
 	Point lastp;
 	double awdst; // awareness distance
+	int wait; // ticks until the next update while far away, or 0
+	Navpath path;
+	int prey; // the player's node when last hunted, or -1
 };
 
 struct Enemy{
@@ -551,10 +799,18 @@ struct Enemy{
 	Ai ai;
 };
 
+/* What an enemy touches, as found by zoneupdate's broadphase. */
+enum{
+	Hitplayer = 1 << 0,
+	Hitsword = 1 << 1,
+};
+
 _Bool enemyldresrc(void);
 _Bool enemyinit(Enemy *e, EnemyID id, int x, int y);
 void enemyfree(Enemy*);
 void enemyupdate(Enemy*, Player*, Zone*);
+/* Called with the Hit flags of what touches the enemy this tick. */
+void enemytouch(Enemy*, Player*, Zone*, int hits);
 void enemydraw(Enemy*, Gfx*);
 
 void aijumper(Ai*, double jv);
@@ -584,12 +840,41 @@ struct Env{
 
 _Bool envldresrc(void);
 _Bool envinit(Env*, EnvID, Point);
-void envupdateanims(void);
 void envupdate(Env*, Zone*);
 void envdraw(Env*,  Gfx*);
 void envact(Env*, Player*, Zone*);
 Point envsize(EnvID);
 
+typedef enum PartID PartID;
+enum PartID{
+	PartNone,
+	PartSplat,
+	PartSpark,
+	PartSplash,
+	PartMax
+};
+
+enum { Maxparts = 128 };
+
+/* Short-lived effects that don't touch anything, kept in a fixed pool
+ * per layer so that they never take the place of items or enemies.
+ * When the pool is full, new particles replace the oldest. */
+typedef struct Parts Parts;
+struct Parts{
+	int next; // the slot the next particle takes
+	unsigned char id[Maxparts];
+	short age[Maxparts];
+	double x[Maxparts], y[Maxparts];
+	double px[Maxparts], py[Maxparts];
+	double dx[Maxparts], dy[Maxparts];
+};
+
+_Bool partldresrc(void);
+/* Add a burst of n particles at loc. */
+void partadd(Parts*, PartID, Point loc, int n);
+void partupdate(Parts*);
+void partdraw(Parts*, Gfx*);
+
 enum {
 	Maxenms = 32,
 	Maxitms = 32,
@@ -606,10 +891,22 @@ struct Zone {
 	Item itms[Maxz][Maxitms];
 	Env envs[Maxz][Maxenvs];
 	Enemy enms[Maxz][Maxenms];
+	Parts parts[Maxz];
+
+	// The navigation graph of each layer, built by zonenav when
+	// it is first needed.
+	Nav *nav[Maxz];
 };
 
 Zone *zoneread(FILE *);
+/* Scan a zone from a NUL-terminated buffer holding an entire zone
+ * file.  The buffer is not modified and, aside from the error string
+ * on failure, no global state is touched, so different buffers may be
+ * scanned concurrently. */
+Zone *zonescan(char *buf);
 void zonewrite(FILE *, Zone *z);
+/* Append the zone, as written by zonewrite, to the buffer. */
+void zoneprint(Buf *, Zone *z);
 void zonefree(Zone *);
 // Zoneadditem returns true if the item was successfully added to the zone.
 // It returns false if either there wasn't a spot for the item or if the item was
@@ -619,6 +916,9 @@ _Bool zoneaddenv(Zone *zn, int z, Env env);
 _Bool zoneaddenemy(Zone *zn, int z, Enemy enm);
 void zonedraw(Gfx *g, Zone *zn, Player *p);
 void zoneupdate(Zone *zn, Player *p, Point *tr);
+/* Returns the navigation graph of layer z, building it if this is
+ * its first use, or NULL if z has none. */
+Nav *zonenav(Zone *zn, int z);
 
 /* Fills the array with locations that pass the given predicate. */
 int zonelocs(Zone *, int z, _Bool (*)(Zone *, int, Point), Point [], int);
@@ -639,16 +939,33 @@ _Bool zoneoverlap(Zone *zn, int z, Point loc, Point wh);
  * l - Player
  * u - uint64_t
  *
- * The return value is true if all items in the format were scanned
- * and false if not.
+ * Fields are blank-separated and scanning stops at the end of the
+ * line.  The return value is true if all items in the format were
+ * scanned and false if not.
  */
 _Bool scangeom(char *buf, char *fmt, ...);
 
+/* Scan a single int like scangeom's 'd', advancing *bufp past it. */
+_Bool scanint(char **bufp, int *);
+
 /* Prints a structure to a string buffer using the same type of format
- * specified as is used by scangeom.  The return value is true if the
- * output was not truncated and false if the output was truncated. */
+ * specified as is used by scangeom.  Doubles are printed as the
+ * shortest decimal that scans back to the same value.  The return
+ * value is true if the output was not truncated and false if the
+ * output was truncated. */
 _Bool printgeom(char *buf, int sz, char *fmt, ...);
 
+/* Packs a structure into buf in a fixed-width, little-endian binary
+ * form using the same format as scangeom.  Doubles are stored
+ * bit-for-bit.  The return value is the number of bytes used, or -1 if
+ * buf is too small. */
+int packgeom(char *buf, int sz, char *fmt, ...);
+
+/* Unpacks a structure packed by packgeom from the sz bytes of buf.
+ * The return value is false if buf is too short or has bytes left
+ * over after the last field. */
+_Bool unpackgeom(char *buf, int sz, char *fmt, ...);
+
 _Bool fsexists(const char *path);
 
 typedef struct Meter Meter;
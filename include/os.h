@@ -6,3 +6,7 @@ FILE *piperead(const char *);
 int pipeclose(FILE*);
 int makedir(const char *);
 const char *appdata(const char *prog);
+/* Flush f's data through to the disk. */
+int filesync(FILE *);
+/* Atomically replace the file at path with the one at tmp. */
+int filereplace(const char *tmp, const char *path);
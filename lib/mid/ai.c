@@ -1,6 +1,7 @@
 /* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
 
 #include "../../include/mid.h"
+#include <math.h>
 
 static void dojump(Enemy*,Player*,Zone*);
 static void walk(Enemy*,Player*,Zone*);
@@ -36,6 +37,8 @@ void aihunter(Ai *ai, double jv, double wv, double awdst){
 	ai->update = hunt;
 	ai->mv = (Point){wv, jv};
 	ai->awdst = awdst;
+	ai->path = (Navpath){0};
+	ai->prey = -1;
 }
 
 static void dojump(Enemy *e, Player *p, Zone *z){
@@ -75,13 +78,21 @@ static void patrol(Enemy *e, Player *p, Zone *z){
 	e->body.vel.x = e->ai.mv.x;
 }
 
+/* Chasers follow the flow field toward the player, but they can't
+ * jump so they head straight for the player instead of climbing. */
 static void chase(Enemy *e, Player *p, Zone *z){
 	if(dist(e->body.bbox.a, p->body.bbox.a) > e->ai.awdst)
 		return; //unaware
 
 	double wx = e->ai.mv.x;
 
-	if(p->body.bbox.a.x < e->body.bbox.a.x)
+	Nav *nv = zonenav(z, z->lvl->z);
+	Tileinfo bi = lvlmajorblk(z->lvl, e->body.bbox);
+	int nx, ny;
+	if(nv && navstep(nv, bi.x, bi.y, &nx, &ny) && ny >= bi.y){
+		if(nx < bi.x)
+			wx = -wx;
+	}else if(p->body.bbox.a.x < e->body.bbox.a.x)
 		wx = -wx;
 
 	e->ai.lastp = e->body.bbox.a;
@@ -89,16 +100,43 @@ static void chase(Enemy *e, Player *p, Zone *z){
 	e->body.vel.x = wx;
 }
 
+/* Hunters follow the flow field toward the player, or a path of
+ * their own if they are too far from the player to be in it, heading
+ * straight for the player only if there is no way there.  Once aware
+ * they stay aware until the player moves, even if the way leads them
+ * away for a while. */
 static void hunt(Enemy *e, Player *p, Zone *z){
-	if(dist(e->body.bbox.a, p->body.bbox.a) > e->ai.awdst)
+	Nav *nv = zonenav(z, z->lvl->z);
+	int prey = nv ? navnode(nv, p->bi.x, p->bi.y) : -1;
+	if((prey < 0 || prey != e->ai.prey) && dist(e->body.bbox.a, p->body.bbox.a) > e->ai.awdst)
 		return; //unaware
+	e->ai.prey = prey;
 
 	double wx = e->ai.mv.x;
+	_Bool up;
+
+	Tileinfo bi = lvlmajorblk(z->lvl, e->body.bbox);
+	int nx, ny;
+	if(nv && (navstep(nv, bi.x, bi.y, &nx, &ny)
+			|| navnext(nv, &e->ai.path, bi.x, bi.y, p->bi.x, p->bi.y, &nx, &ny))){
+		if(nx < bi.x)
+			wx = -wx;
+		up = ny < bi.y;
+
+		// Jumps are from within a column, so line up first.
+		double bw = e->body.bbox.b.x - e->body.bbox.a.x;
+		double dx = bi.x * Twidth + (Twidth - bw) / 2 - e->body.bbox.a.x;
+		if(up && !e->body.fall && dx != 0){
+			wx = fabs(dx) < e->ai.mv.x ? dx : copysign(e->ai.mv.x, dx);
+			up = 0;
+		}
+	}else{
+		if(p->body.bbox.a.x < e->body.bbox.a.x)
+			wx = -wx;
+		up = p->body.bbox.a.y < e->body.bbox.a.y;
+	}
 
-	if(p->body.bbox.a.x < e->body.bbox.a.x)
-		wx = -wx;
-
-	if(!e->body.fall && p->body.bbox.a.y < e->body.bbox.a.y){
+	if(!e->body.fall && up){
 		e->body.vel.y = -e->ai.mv.y;
 		e->body.fall = 1;
 	}
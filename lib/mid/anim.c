@@ -3,21 +3,17 @@
 #include "../../include/mid.h"
 #include <assert.h>
 
-void animupdate(Anim *a)
+int animframe(const Anim *a, unsigned long tick)
 {
-	a->d--;
-	if(a->d > 0)
-		return;
-	a->d = a->delay;
-	a->f++;
-	if(a->f == a->len)
-		a->f = 0;
+	// Delays shorter than a tick round down to 0.
+	unsigned long d = a->delay > 0 ? a->delay : 1;
+	return (tick - a->start) / d % a->len;
 }
 
 void animdraw(Gfx *g, Anim *a, Point p)
 {
 	double y = a->row * a->h;
-	double x = a->f * a->w;
+	double x = animframe(a, curtick) * a->w;
 	Rect clip = {
 		{ x, y },
 		{ x + a->w, y + a->h }
@@ -27,6 +23,5 @@ void animdraw(Gfx *g, Anim *a, Point p)
 
 void animreset(Anim *a)
 {
-	a->f = 0;
-	a->d = a->delay;
+	a->start = curtick;
 }
@@ -13,6 +13,9 @@ struct ArmorOps{
 
 static void nobonus(Player*);
 static void ironbonus(Player*);
+static void imgreloaded(void *);
+
+static unsigned long reloads;
 
 static ArmorOps ops[] = {
 	[ArmorSetNone] = {
@@ -48,6 +51,7 @@ void armorinit(void){
 			assert(op->parts[j] != NULL);
 		}
 	}
+	rtabonreload(imgs, imgreloaded);
 }
 
 void applyarmorbonus(Player *p, ArmorSetID id){
@@ -62,6 +66,19 @@ Img *armorinvsheet(ArmorSetID id){
 	return ops[id].invsheet;
 }
 
+unsigned long armorreloads(void){
+	return reloads;
+}
+
+static void imgreloaded(void *img){
+	for(int i = ArmorSetNone; i < ArmorSetMax; i++){
+		for(int j = ArmorBackArm; j < ArmorMax; j++){
+			if(ops[i].parts[j] == img)
+				reloads++;
+		}
+	}
+}
+
 static void nobonus(Player *p){
 	// nada
 }
@@ -15,11 +15,39 @@ void bodyinit(Body *b, int x, int y, int w, int h)
 		.bbox = { { x, y }, { x + w, y + h } },
 		.vel = { 0, 0 },
 		.acc = { 0, 0 },
-		.fall = false
+		.fall = false,
+		.prev = { x, y },
 	};
 }
 
+void bodystart(Body *b)
+{
+	b->prev = b->bbox.a;
+}
+
+Point bodydrawpt(const Body *b)
+{
+	return ticklerp(b->prev, b->bbox.a);
+}
+
+Point ticklerp(Point prev, Point cur)
+{
+	Point d = { cur.x - prev.x, cur.y - prev.y };
+	if (fabs(d.x) > Twidth || fabs(d.y) > Theight)
+		return cur;
+	return (Point){ prev.x + d.x * tickalpha, prev.y + d.y * tickalpha };
+}
+
 void bodyupdate(Body *b, Lvl *l)
+{
+#ifdef FIXPHYS
+	bodyupdatefix(b, l);
+#else
+	bodyupdatedbl(b, l);
+#endif
+}
+
+void bodyupdatedbl(Body *b, Lvl *l)
 {
 	bodymv(b, l);
 	if (b->fall && b->vel.y < Maxdy)
@@ -33,17 +61,23 @@ static void bodymv(Body *b, Lvl *l)
 	Isect fallis = (Isect) { .is = false };
 	Point v = b->vel;
 	Point left = (Point) { fabs(v.x), fabs(v.y) };
+	Sweep s;
+	lvlsweep(l, b->bbox, v, &s);
 
 	while (left.x > 0.0 || left.y > 0.0) {
 		Point d = velstep(b, v);
 		left.x -= fabs(d.x);
 		left.y -= fabs(d.y);
-		Isect is = lvlisect(l, b->bbox, d);
+		Isect is = sweepisect(&s, b->bbox, d);
 		if (is.is && is.dy != 0.0)
 			fallis = is;
 
 		d.x = d.x + -xmul * is.dx;
 		d.y = d.y + -ymul * is.dy;
+		// If nothing moved then each further step would be the
+		// same, and rounding can leave left > 0 with v == 0.
+		if (d.x == 0.0 && d.y == 0.0)
+			break;
 		v.x -= d.x;
 		v.y -= d.y;
 
@@ -16,7 +16,7 @@ Info dainfo = {
 		.item = { ItemNone, ItemBroadSwd },
 		.prob = { 80, 20 }
 	},
-	.death = EnemySplat
+	.death = PartSplat
 };
 
 _Bool dainit(Enemy *e, int x, int y){
@@ -32,6 +32,10 @@ void daupdate(Enemy *e, Player *p, Zone *z){
 	enemygenupdate(e, p, z, &dainfo);
 }
 
+void datouch(Enemy *e, Player *p, Zone *z, int hits){
+	enemygentouch(e, p, z, &dainfo, hits);
+}
+
 void dadraw(Enemy *e, Gfx *g){
 	if(e->iframes % 4 != 0)
 		return;
@@ -47,7 +51,7 @@ void dadraw(Enemy *e, Gfx *g){
 			{ 32, 0 },
 			{ 64, 32 }
 		};
-	camdrawreg(g, daimg, clip, e->body.bbox.a);
+	camdrawreg(g, daimg, clip, bodydrawpt(&e->body));
 }
 
 _Bool dascan(char *buf, Enemy *e){
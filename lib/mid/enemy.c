@@ -7,6 +7,19 @@
 
 static Rng rng;
 
+/* Enemies within Activedst of the player are updated every tick.
+ * Farther ones can't reach the player or the sword, so they only
+ * think every Farticks ticks, staggered by their slot in the zone,
+ * and those beyond Wakedst sleep until the player comes back. */
+enum{
+	Activedst = Scrnw,
+	Wakedst = 2 * Scrnw,
+	Farticks = 8,
+};
+
+static _Bool farupdate(Enemy*, Player*, Zone*);
+static _Bool resting(Body*);
+
 _Bool enemyldresrc(void){
 	untihit = resrcacq(sfx, "sfx/hit.wav", 0);
 	if(!untihit) return 0;
@@ -45,12 +58,13 @@ struct Enemymt{
 	_Bool (*init)(Enemy *, int, int);
 	void (*free)(Enemy*);
 	void (*update)(Enemy*, Player*, Zone*);
+	void (*touch)(Enemy*, Player*, Zone*, int);
 	void (*draw)(Enemy*, Gfx*);
 	_Bool (*scan)(char *, Enemy *);
 	_Bool (*print)(char *, size_t, Enemy *);
 };
 
-#define ENEMYMT(e) e##init, e##free, e##update, e##draw, e##scan, e##print
+#define ENEMYMT(e) e##init, e##free, e##update, e##touch, e##draw, e##scan, e##print
 
 static Enemymt mt[] = {
 	[EnemyUnti] = { ENEMYMT(unti) },
@@ -83,6 +97,10 @@ void enemyupdate(Enemy *e, Player *p, Zone *z){
 	if(e->id) mt[e->id].update(e, p, z);
 }
 
+void enemytouch(Enemy *e, Player *p, Zone *z, int hits){
+	if(e->id) mt[e->id].touch(e, p, z, hits);
+}
+
 void enemydraw(Enemy *e, Gfx *g){
 	if(e->id) {
 		if(debugging)
@@ -94,7 +112,7 @@ void enemydraw(Enemy *e, Gfx *g){
 _Bool enemyscan(char *buf, Enemy *e){
 	int id;
 	// need to take a peek at the ID to dispatch the correct scan method.
-	if (sscanf(buf, " %d", &id) != 1)
+	if (!scangeom(buf, "d", &id) || id <= 0 || id >= EnemyMax)
 		return 0;
 	if (!mt[id].scan)
 		return defaultscan(buf, e); 
@@ -116,6 +134,10 @@ _Bool defaultprint(char *buf, size_t sz, Enemy *e){
 }
 
 void enemygenupdate(Enemy *e, Player *p, Zone *z, Info *i){
+	if(e->iframes == 0 && farupdate(e, p, z))
+		return;
+	e->ai.wait = 0;
+
 	e->ai.update(e, p, z);
 
 	if(e->iframes > 0){
@@ -126,17 +148,19 @@ void enemygenupdate(Enemy *e, Player *p, Zone *z, Info *i){
 	if(e->iframes <= 0)
 		e->hitback = 0;
 
-	bodyupdate(&e->body, z->lvl);
+	if(!resting(&e->body))
+		bodyupdate(&e->body, z->lvl);
+}
 
+void enemygentouch(Enemy *e, Player *p, Zone *z, Info *i, int hits){
 	Rect pbbox = playerbox(p);
 
-	if(isect(e->body.bbox, pbbox)){
+	if(hits & Hitplayer){
 		int dir = e->body.bbox.a.x > pbbox.a.x ? -1 : 1;
 		playerdmg(p, i->stats[StatStr], dir);
 	}
 
-	Rect swbb = swordbbox(&p->sw);
-	if(e->iframes == 0 && p->sframes > 0 && isect(e->body.bbox, swbb)){
+	if(e->iframes == 0 && (hits & Hitsword)){
 		sfxplay(i->hit);
 		int pstr = swordstr(&p->sw, p);
 		e->hp -= pstr;
@@ -149,12 +173,13 @@ void enemygenupdate(Enemy *e, Player *p, Zone *z, Info *i){
 		e->hitback = pbbox.a.x < e->body.bbox.a.x ? mhb : -mhb;
 		e->iframes = 500.0 / Ticktm; // 0.5s
 
+		Parts *ps = &z->parts[z->lvl->z];
+		Rect bb = e->body.bbox;
+		partadd(ps, PartSpark, (Point){ (bb.a.x + bb.b.x) / 2, (bb.a.y + bb.b.y) / 2 }, 5);
+
 		if(e->hp <= 0){
-			Enemy splat = {};
-			enemyinit(&splat, i->death, 0, 0);
-			splat.body = e->body;
+			partadd(ps, i->death, bb.a, 1);
 			enemyfree(e);
-			*e = splat;
 
 			int n = rngintincl(&rng, 0, 100);
 			Drops *d = &i->drops;
@@ -174,3 +199,31 @@ void enemygenupdate(Enemy *e, Player *p, Zone *z, Info *i){
 		}
 	}
 }
+
+/* Returns 1 if the enemy is too far from the player for a full update,
+ * after giving it the update that it gets at its distance. */
+static _Bool farupdate(Enemy *e, Player *p, Zone *z){
+	double d = dist(e->body.bbox.a, p->body.bbox.a);
+	if(d <= Activedst)
+		return 0;
+	if(d > Wakedst)
+		return 1;
+
+	if(e->ai.wait == 0)
+		e->ai.wait = 1 + (e - z->enms[z->lvl->z]) % Farticks;
+	if(--e->ai.wait == 0){
+		e->ai.update(e, p, z);
+		e->ai.wait = Farticks;
+	}
+
+	if(!resting(&e->body))
+		bodyupdate(&e->body, z->lvl);
+	return 1;
+}
+
+/* A body that has landed presses down on the ground with vel.y > 0,
+ * so if it is standing still then it stays put, since the ground
+ * under it never changes. */
+static _Bool resting(Body *b){
+	return !b->fall && b->vel.x == 0 && b->vel.y > 0;
+}
@@ -22,15 +22,17 @@ struct Info{
 	int stats[StatMax];
 	Drops drops;
 	Sfx *hit;
-	EnemyID death;
+	PartID death;
 };
 
 void enemygenupdate(Enemy*,Player*,Zone*,Info*);
+void enemygentouch(Enemy*,Player*,Zone*,Info*,int);
 
 #define ENEMYDECL(e) \
 _Bool e##init(Enemy*,int,int);\
 void e##free(Enemy*);\
 void e##update(Enemy*,Player*,Zone*);\
+void e##touch(Enemy*,Player*,Zone*,int);\
 void e##draw(Enemy*,Gfx*);\
 _Bool e##scan(char*,Enemy*);\
 _Bool e##print(char*,size_t,Enemy*);\
@@ -27,31 +27,31 @@ static EnvOps ops[] = {
 		"img/shrine.png",
 		shremptyact,
 		{ 32, 64 },
-		{ .row = 0, .len = 1, .delay = 1, .w = 32, .h = 64, .d = 1}
+		{ .row = 0, .len = 1, .delay = 1, .w = 32, .h = 64}
 	},
 	[EnvShrused] = {
 		"img/shrine.png",
 		shrusedact,
 		{ 32, 64 },
-		{ .row = 1, .len = 1, .delay = 1, .w = 32, .h = 64, .d = 1 }
+		{ .row = 1, .len = 1, .delay = 1, .w = 32, .h = 64 }
 	},
 	[EnvSwdStoneHp] = {
 		"img/swstones.png",
 		stonehpact,
 		{ 32, 32 },
-		{ .row = 0, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 }
+		{ .row = 0, .len = 1, .delay = 1, .w = 32, .h = 32 }
 	},
 	[EnvSwdStoneDex] = {
 		"img/swstones.png",
 		stonedexact,
 		{ 32, 32 },
-		{ .row = 1, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 }
+		{ .row = 1, .len = 1, .delay = 1, .w = 32, .h = 32 }
 	},
 	[EnvSwdStoneStr] = {
 		"img/swstones.png",
 		stonestract,
 		{ 32, 32 },
-		{ .row = 2, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 }
+		{ .row = 2, .len = 1, .delay = 1, .w = 32, .h = 32 }
 	},
 };
 
@@ -94,11 +94,6 @@ Point envsize(EnvID id){
 	return ops[id].wh;
 }
 
-void envupdateanims(void){
-	for(size_t i = 1; i < EnvMax; i++)
-		animupdate(&ops[i].anim);
-}
-
 void envupdate(Env *e, Zone *z){
 	bodyupdate(&e->body, z->lvl);
 }
@@ -106,7 +101,7 @@ void envupdate(Env *e, Zone *z){
 void envdraw(Env *e, Gfx *g){
 	if(e->id && debugging)
 		camfillrect(g, e->body.bbox, (Color){255,0,0,255});
-	camdrawanim(g, &ops[e->id].anim, e->body.bbox.a);
+	camdrawanim(g, &ops[e->id].anim, bodydrawpt(&e->body));
 }
 
 void envact(Env *e, Player *p, Zone *z){
@@ -9,38 +9,48 @@
 enum { assert_keychar_eq = 1/!!('a' == SDLK_a) };
 
 extern _Bool keyrpt(SDL_Event*);
-
-static int prevtm = 0;
+extern _Bool gfxthreaded(void);
+extern void gfxreset(void);
 
 double meanftime = 0.0;
+double tickalpha = 1.0;
+unsigned long curtick;
 static unsigned int nframes = 0;
 static bool ignframe = false;
 
-void framestart(void){
-	prevtm = SDL_GetTicks();
-}
-
 void ignframetime(void)
 {
 	ignframe = true;
 }
 
-void framefinish(void){
-	int time = SDL_GetTicks();
-	int delay = prevtm + Ticktm - time;
-	int ftime = time - prevtm;
-	if (!ignframe) {
+double framems(void){
+	return SDL_GetPerformanceCounter() * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+/* Records the time taken by a frame, returning false if the frame was
+ * to be ignored. */
+_Bool framefinish(double ftime){
+	if (ignframe) {
 		ignframe = false;
-		nframes++;
-		meanftime = meanftime + ((ftime - meanftime) / nframes);
+		return false;
 	}
-	if(delay > 0)
-		SDL_Delay(delay);
+	nframes++;
+	meanftime = meanftime + ((ftime - meanftime) / nframes);
+	return true;
+}
+
+void framedelay(int ms){
+	SDL_Delay(ms);
 }
 
 _Bool pollevent(Event *event){
 	SDL_Event e;
-	int p = SDL_PollEvent(&e);
+	int p;
+	// Under gfxrun, only the main thread may pump events.
+	if(gfxthreaded())
+		p = SDL_PeepEvents(&e, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0;
+	else
+		p = SDL_PollEvent(&e);
 	if(!p)
 		return 0;
 
@@ -75,6 +85,10 @@ _Bool pollevent(Event *event){
 		event->y = y;
 		event->butt = e.button.button;
 		return 1;
+	case SDL_RENDER_TARGETS_RESET:
+	case SDL_RENDER_DEVICE_RESET:
+		gfxreset();
+		return 0;
 	default:
 		return 0;
 	}
@@ -0,0 +1,378 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+/* Bodyupdate in 24.8 fixed point.  This follows body.c, lvlisect,
+ * lvlsweep, sweepisect and isection step for step, so that starting
+ * from the same state on the 1/256 grid it computes the same values
+ * as the double version, whose operations are all exact there. */
+
+#include "../../include/mid.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+typedef int32_t Fix;
+
+enum { Fixone = 1 << 8 };
+
+typedef struct Fpt Fpt;
+struct Fpt {
+	Fix x, y;
+};
+
+typedef struct Frect Frect;
+struct Frect {
+	Fpt a, b;
+};
+
+typedef struct Fisect Fisect;
+struct Fisect {
+	bool is;
+	Fix dx, dy;
+};
+
+typedef struct Fbody Fbody;
+struct Fbody {
+	Frect bbox;
+	Fpt vel;
+	Fpt acc;
+	bool fall;
+};
+
+typedef struct Fsweep Fsweep;
+struct Fsweep {
+	Lvl *lvl;
+	Frect box;
+	int n;
+	Frect tiles[Maxsweep];
+};
+
+static void bodymv(Fbody *b, Lvl *l);
+static Fpt velstep(Fbody *b, Fpt v);
+static Fix tillwhole(Fix loc, Fix vel);
+static void dofall(Fbody *b, Lvl *l, Fisect is);
+static void sweep(Lvl *l, Frect r, Fpt v, Fsweep *s);
+static Fisect sweepis(Fsweep *s, Frect r, Fpt v);
+static Fisect lvlis(Lvl *l, Frect r, Fpt v);
+static Frect hitzone(Frect a, Fpt v);
+static Frect tilebbox(int x, int y);
+static Fisect fisection(Frect a, Frect b);
+static Fix isect1d(Fix a0, Fix a1, Fix b0, Fix b1);
+static bool inbox(Frect box, Frect r);
+static Frect rnorm(Frect r);
+static void rmv(Frect *r, Fix dx, Fix dy);
+static Fix ceilfix(Fix f);
+static Fix floorfix(Fix f);
+static Fix fixabs(Fix f);
+static Fix tofix(double d);
+static double fromfix(Fix f);
+
+void bodyupdatefix(Body *b, Lvl *l)
+{
+	Fbody fb = {
+		.bbox = {
+			{ tofix(b->bbox.a.x), tofix(b->bbox.a.y) },
+			{ tofix(b->bbox.b.x), tofix(b->bbox.b.y) },
+		},
+		.vel = { tofix(b->vel.x), tofix(b->vel.y) },
+		.acc = { tofix(b->acc.x), tofix(b->acc.y) },
+		.fall = b->fall,
+	};
+
+	bodymv(&fb, l);
+	if (fb.fall && fb.vel.y < Maxdy * Fixone)
+		fb.vel.y += fb.acc.y;
+
+	b->bbox = (Rect){
+		{ fromfix(fb.bbox.a.x), fromfix(fb.bbox.a.y) },
+		{ fromfix(fb.bbox.b.x), fromfix(fb.bbox.b.y) },
+	};
+	b->vel = (Point){ fromfix(fb.vel.x), fromfix(fb.vel.y) };
+	b->acc = (Point){ fromfix(fb.acc.x), fromfix(fb.acc.y) };
+	b->fall = fb.fall;
+}
+
+static void bodymv(Fbody *b, Lvl *l)
+{
+	Fix xmul = b->vel.x > 0 ? 1 : -1;
+	Fix ymul = b->vel.y > 0 ? 1 : -1;
+	Fisect fallis = (Fisect) { .is = false };
+	Fpt v = b->vel;
+	Fpt left = (Fpt) { fixabs(v.x), fixabs(v.y) };
+	Fsweep s;
+	sweep(l, b->bbox, v, &s);
+
+	while (left.x > 0 || left.y > 0) {
+		Fpt d = velstep(b, v);
+		left.x -= fixabs(d.x);
+		left.y -= fixabs(d.y);
+		Fisect is = sweepis(&s, b->bbox, d);
+		if (is.is && is.dy != 0)
+			fallis = is;
+
+		d.x = d.x + -xmul * is.dx;
+		d.y = d.y + -ymul * is.dy;
+		if (d.x == 0 && d.y == 0)
+			break;
+		v.x -= d.x;
+		v.y -= d.y;
+
+		rmv(&b->bbox, d.x, d.y);
+	}
+	dofall(b, l, fallis);
+}
+
+static Fpt velstep(Fbody *b, Fpt v)
+{
+	Fpt loc = b->bbox.a;
+	Fpt d = (Fpt) { tillwhole(loc.x, v.x), tillwhole(loc.y, v.y) };
+	if (d.x == 0 && v.x != 0)
+		d.x = v.x > 0 ? Fixone : -Fixone;
+	if (fixabs(d.x) > fixabs(v.x))
+		d.x = v.x;
+	if (d.y == 0 && v.y != 0)
+		d.y = v.y > 0 ? Fixone : -Fixone;
+	if (fixabs(d.y) > fixabs(v.y))
+		d.y = v.y;
+	return d;
+}
+
+static Fix tillwhole(Fix loc, Fix vel)
+{
+	if (vel > 0)
+		return ceilfix(loc) - loc;
+	return floorfix(loc) - loc;
+}
+
+static void dofall(Fbody *b, Lvl *l, Fisect is)
+{
+	// lvlmajorblk: the block under the middle of the body.
+	Frect r = rnorm(b->bbox);
+	int x = (r.b.x + r.a.x) / (2 * Twidth * Fixone);
+	int y = (r.b.y + r.a.y) / (2 * Theight * Fixone);
+	Fix g = tofix(blkgrav(tileinfo(l, x, y, l->z).flags));
+
+	if(b->vel.y > 0 && is.dy > 0 && b->fall) { /* hit the ground */
+		b->acc.y = g;
+		b->fall = false;
+	} else if (b->vel.y < 0 && is.dy > 0) { /* hit my head on something */
+		b->vel.y = 0;
+		b->acc.y = g;
+		b->fall = true;
+	}
+	if (!is.is && !b->fall) { /* are we falling now? */
+		b->vel.y = 0;
+		b->acc.y = g;
+		b->fall = true;
+	}
+}
+
+static void sweep(Lvl *l, Frect r, Fpt v, Fsweep *s)
+{
+	Frect mv = r;
+	rmv(&mv, v.x, v.y);
+	r = rnorm(r);
+	mv = rnorm(mv);
+	s->lvl = l;
+	s->box = (Frect){
+		{ r.a.x < mv.a.x ? r.a.x : mv.a.x, r.a.y < mv.a.y ? r.a.y : mv.a.y },
+		{ r.b.x > mv.b.x ? r.b.x : mv.b.x, r.b.y > mv.b.y ? r.b.y : mv.b.y },
+	};
+	s->n = 0;
+
+	Frect z = hitzone(r, v);
+	for (int x = z.a.x; x <= z.b.x; x++) {
+		for (int y = z.a.y; y <= z.b.y; y++) {
+			if (!lvlhas(l, x, y, l->z, Pcollide))
+				continue;
+			Frect tb = tilebbox(x, y);
+			if (!fisection(s->box, tb).is)
+				continue;
+			if (s->n == Maxsweep) {
+				s->box = (Frect){ { 1, 1 }, { 0, 0 } };
+				return;
+			}
+			s->tiles[s->n++] = tb;
+		}
+	}
+}
+
+static Fisect sweepis(Fsweep *s, Frect r, Fpt v)
+{
+	Fisect isect = (Fisect) { .is = false };
+	Frect mv = r;
+	rmv(&mv, 0, v.y);
+	if (!inbox(s->box, mv))
+		return lvlis(s->lvl, r, v);
+	for (int i = 0; i < s->n; i++) {
+		Fisect is = fisection(mv, s->tiles[i]);
+		if (is.is && is.dy > isect.dy) {
+			isect.is = true;
+			isect.dy = is.dy;
+		}
+	}
+
+	if (v.x == 0)
+		return isect;
+	if (isect.dy > fixabs(v.y))
+		return lvlis(s->lvl, r, v);
+
+	mv = r;
+	rmv(&mv, v.x, v.y + (v.y < 0 ? isect.dy : -isect.dy));
+	if (!inbox(s->box, mv))
+		return lvlis(s->lvl, r, v);
+	for (int i = 0; i < s->n; i++) {
+		Fisect is = fisection(mv, s->tiles[i]);
+		if (is.is && is.dx > isect.dx) {
+			isect.is = true;
+			isect.dx = is.dx;
+		}
+	}
+
+	return isect;
+}
+
+static Fisect lvlis(Lvl *l, Frect r, Fpt v)
+{
+	Frect test = hitzone(r, v);
+
+	Fisect isect = (Fisect) { .is = false };
+	for (int pass = 0; pass < 2; pass++) {
+		Frect mv = r;
+		if (pass == 0)
+			rmv(&mv, 0, v.y);
+		else if (v.x == 0)
+			break;
+		else
+			rmv(&mv, v.x, v.y + (v.y < 0 ? isect.dy : -isect.dy));
+
+		for (int x = test.a.x; x <= test.b.x; x++) {
+			for (int y = test.a.y; y <= test.b.y; y++) {
+				if (!lvlhas(l, x, y, l->z, Pcollide))
+					continue;
+				Fisect is = fisection(mv, tilebbox(x, y));
+				if (!is.is)
+					continue;
+				if (pass == 0 && is.dy > isect.dy) {
+					isect.is = true;
+					isect.dy = is.dy;
+				} else if (pass == 1 && is.dx > isect.dx) {
+					isect.is = true;
+					isect.dx = is.dx;
+				}
+			}
+		}
+	}
+	return isect;
+}
+
+/* The range of tiles, as a Frect in tile coordinates, that a move by
+ * v may touch.  The ymin test is as in lvl.c's hitzone. */
+static Frect hitzone(Frect a, Fpt v)
+{
+	Frect b = a;
+	rmv(&b, v.x, v.y);
+
+	a = rnorm(a);
+	b = rnorm(b);
+
+	int xmin = (a.a.x < b.a.x ? a.a.x : b.a.x) / Fixone;
+	int ymin = (a.a.y < b.b.y ? a.a.y : b.a.y) / Fixone;
+	int xmax = (a.b.x > b.b.x ? ceilfix(a.b.x) : ceilfix(b.b.x)) / Fixone;
+	int ymax = (a.b.y > b.b.y ? ceilfix(a.b.y) : ceilfix(b.b.y)) / Fixone;
+	xmin /= Twidth;
+	xmax /= Twidth;
+	ymin /= Theight;
+	ymax /= Theight;
+	if (ymin > 0)
+		ymin--;
+
+	return (Frect) { .a = {xmin, ymin}, .b = {xmax, ymax} };
+}
+
+static Frect tilebbox(int x, int y)
+{
+	Fpt a = (Fpt) {x * Twidth * Fixone, y * Theight * Fixone};
+	Fpt b = (Fpt) {(x + 1) * Twidth * Fixone, (y + 1) * Theight * Fixone};
+	return (Frect){ .a = a, .b = b };
+}
+
+static Fisect fisection(Frect a, Frect b)
+{
+	a = rnorm(a);
+	b = rnorm(b);
+	Fix ix = isect1d(a.a.x, a.b.x, b.a.x, b.b.x);
+	if (ix <= 0)
+		return (Fisect){ .is = false };
+	Fix iy = isect1d(a.a.y, a.b.y, b.a.y, b.b.y);
+	if (iy <= 0)
+		return (Fisect){ .is = false };
+	return (Fisect){ .is = true, .dx = ix, .dy = iy };
+}
+
+static Fix isect1d(Fix a0, Fix a1, Fix b0, Fix b1)
+{
+	if (a1 >= b0 && a1 <= b1)
+		return a1 - b0;
+	else if (b1 >= a0 && b1 <= a1)
+		return b1 - a0;
+	return -1;
+}
+
+static bool inbox(Frect box, Frect r)
+{
+	return r.a.x >= box.a.x && r.b.x <= box.b.x
+		&& r.a.y >= box.a.y && r.b.y <= box.b.y;
+}
+
+static Frect rnorm(Frect r)
+{
+	Frect n = r;
+	if (r.a.x > r.b.x) {
+		n.a.x = r.b.x;
+		n.b.x = r.a.x;
+	}
+	if (r.a.y > r.b.y) {
+		n.a.y = r.b.y;
+		n.b.y = r.a.y;
+	}
+	return n;
+}
+
+static void rmv(Frect *r, Fix dx, Fix dy)
+{
+	r->a.x += dx;
+	r->a.y += dy;
+	r->b.x += dx;
+	r->b.y += dy;
+}
+
+/* The nearest whole pixel at or above f. */
+static Fix ceilfix(Fix f)
+{
+	return -floorfix(-f);
+}
+
+/* The nearest whole pixel at or below f, without relying on >> of a
+ * negative number. */
+static Fix floorfix(Fix f)
+{
+	Fix q = f / Fixone;
+	if (f % Fixone != 0 && f < 0)
+		q--;
+	return q * Fixone;
+}
+
+static Fix fixabs(Fix f)
+{
+	return f < 0 ? -f : f;
+}
+
+static Fix tofix(double d)
+{
+	return (Fix) floor(d * Fixone + 0.5);
+}
+
+static double fromfix(Fix f)
+{
+	return (double) f / Fixone;
+}
@@ -16,5 +16,17 @@
 /* Concatinate path names.  'cat' must be of size PATH_MAX + 1. */
 void fscat(const char *d, const char *f, char cat[]);
 
+/* A Watch reports files that are written or replaced in a set of
+ * directories.  It is only implemented for Linux, with inotify;
+ * elsewhere watchnew fails. */
+typedef struct Watch Watch;
+
+Watch *watchnew(void);
+_Bool watchdir(Watch *, const char *dir);
+/* Gets the path of the next changed file without blocking.  Returns
+ * false if there are none. */
+_Bool watchnext(Watch *, char path[PATH_MAX + 1]);
+void watchfree(Watch *);
+
 
 #endif  // !_FS_H_
@@ -4,25 +4,165 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* SDL_RenderGeometry and SDL_Vertex are new in SDL 2.0.18.  With an
+ * older SDL, each quad is drawn by itself with SDL_RenderCopy or
+ * SDL_RenderFillRect instead; see quadsdraw. */
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+typedef SDL_Vertex Vert;
+#else
+typedef struct Vert Vert;
+struct Vert{
+	struct{ float x, y; } position;
+	SDL_Color color;
+	struct{ float x, y; } tex_coord;
+};
+#endif
+
+/* Image draws are recorded as sprites and submitted in batches, one
+ * SDL_RenderGeometry call per batch, when something else is drawn or
+ * the frame is flipped.  A sprite joins the most recent batch for its
+ * texture unless a later batch overlaps it, so the result looks the
+ * same as drawing every sprite in order. */
+typedef struct Sprite Sprite;
+struct Sprite{
+	SDL_Rect src, dst;
+	int next;	/* next sprite in the same batch, or -1 */
+};
+
+typedef struct Batch Batch;
+struct Batch{
+	SDL_Texture *tex;
+	int texw, texh;
+	SDL_Rect bbox;	/* bounds of the batch's sprites' dsts */
+	int first, last, n;
+};
+
+/* Everything drawn is recorded as a command in a Frame.  Under gfxrun
+ * the simulation thread records a frame while the main thread replays
+ * and presents the one before it; the frames are swapped by gfxflip.
+ * Otherwise each command is replayed as soon as it is recorded.  A
+ * recorded frame refers to nothing that the simulation may change, so
+ * it can be replayed while the next one is drawn. */
+enum { Cclear, Cpoint, Cfill, Crect, Cgeom, Ctext, Ctarget, Csetpx, Cfree, Ccopy };
+
+typedef struct Cmd Cmd;
+struct Cmd{
+	int op;
+	Color c;
+	SDL_Rect r;
+	SDL_Texture *tex;	/* Cgeom (NULL for colored quads), Ctarget, Csetpx and Ccopy */
+	SDL_Rect src;	/* Ccopy's region of tex */
+	int vert, ind, n;	/* Cgeom's first vertex and index, and its quads */
+	SDL_Surface *srf;	/* Ctext's rendered text, freed by the replay */
+	Color *px;	/* Csetpx's pixels, freed by the replay */
+	int pitch;
+	Img *img;	/* Cfree's image */
+};
+
+typedef struct Frame Frame;
+struct Frame{
+	Cmd *cmds;
+	int ncmds, szcmds;
+	Vert *verts;
+	int nverts, szverts;
+	int *inds;
+	int ninds, szinds;
+};
 
 struct Gfx{
 	SDL_Window *win;
 	SDL_Renderer *rend;
 	Point tr;
+	unsigned long resets;	/* of the render targets */
+
+	Sprite *sprs;
+	int nsprs, szsprs;
+	Batch *bats;
+	int nbats, szbats;
+
+	Frame frames[2];
+	Frame *back;	/* being recorded */
+	Frame *front;	/* being replayed, if ready */
+
+	/* Shared by the threads under gfxrun. */
+	_Bool threaded;
+	SDL_mutex *mtx;
+	SDL_cond *cond;
+	_Bool ready;	/* front is waiting to be replayed */
+	_Bool done;	/* the simulation has returned */
+	void (*callfn)(void *);	/* a rendercall waiting to be run */
+	void *callarg;
+};
+
+/* An atlas is a texture shared by several images. */
+typedef struct Atlas Atlas;
+struct Atlas{
+	SDL_Texture *tex;
+	int refs;
+};
+
+struct Img{
+	SDL_Texture *tex;
+	int texw, texh;
+	int x, y, w, h;	/* the image's region of tex */
+	Atlas *atlas;	/* NULL if the image owns tex */
+};
+
+/* A texture to be created on the render thread. */
+typedef struct Texreq Texreq;
+struct Texreq{
+	SDL_Surface *srf;	/* the pixels, or NULL for a blank texture */
+	Uint32 fmt;
+	int access, w, h;
+	_Bool blend;
+	SDL_Texture *tex;	/* the result */
 };
 
+enum { Atlasw = 1024, Atlasmaxh = 2048, Atlaspad = 1 };
+
+/* While waiting for a frame, the main thread pumps events every
+ * Pumptm ms. */
+enum { Pumptm = 5 };
+
 static Gfx gfx;
 
 enum { Bufsize = 256 };
 
-static Img *vtxt2img(Gfx *g, Txt *t, const char *fmt, va_list ap);
+static SDL_Surface *vtxtsrf(Txt *t, const char *fmt, va_list ap);
 static Point vtxtdims(const Txt *t, const char *fmt, va_list ap);
+static SDL_Texture *srf2tex(SDL_Surface *);
+static Img *texnew(Texreq *);
+static void texcreate(void *);
+static void texdestroy(void *);
+static void rendercall(Gfx *, void (*)(void *), void *);
+static int simthrd(void *);
+static void record(Gfx *, Cmd);
+static void framereplay(Gfx *, Frame *);
+static void cmdexec(Gfx *, Frame *, Cmd *);
+static void quadsdraw(Gfx *, Frame *, Cmd *);
+static void imgrelease(Img *);
+static void spritedraw(Gfx *, Img *, SDL_Rect src, SDL_Rect dst);
+static void gfxflush(Gfx *);
+static void batchsubmit(Gfx *, Batch *);
+static Vert *geomquads(Frame *, int n, Cmd *);
+static void fillrects(Gfx *, Rect *, int n, Color, Point off);
+static _Bool rectsoverlap(SDL_Rect, SDL_Rect);
+static int atlaspack(SDL_Surface *srfs[], int n, SDL_Rect locs[]);
+static SDL_Rect rectunion(SDL_Rect, SDL_Rect);
 
 Gfx *gfxinit(int w, int h, const char *title){
 	if(TTF_Init() < 0)
 		return NULL;
+	// Images are decoded by the resource loader threads, so
+	// initialize the PNG decoder now instead of lazily in IMG_Load.
+	IMG_Init(IMG_INIT_PNG);
 
 	if (SDL_WasInit(0) == 0) {
 		if(SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -40,16 +180,33 @@ Gfx *gfxinit(int w, int h, const char *title){
 	if (gfx.win == 0)
 		return NULL;
 
-	gfx.rend = SDL_CreateRenderer(gfx.win, -1, 0);
+	// Frames are drawn at the display's refresh rate if possible.
+	gfx.rend = SDL_CreateRenderer(gfx.win, -1, SDL_RENDERER_PRESENTVSYNC);
+	if (!gfx.rend)
+		gfx.rend = SDL_CreateRenderer(gfx.win, -1, 0);
 	if (!gfx.rend){
 		SDL_DestroyWindow(gfx.win);
 		return NULL;
 	}
 
+	gfx.back = &gfx.frames[0];
+	gfx.front = &gfx.frames[1];
+
 	return &gfx;
 }
 
 void gfxfree(Gfx *g){
+	xfree(g->sprs);
+	xfree(g->bats);
+	for(int i = 0; i < 2; i++){
+		xfree(g->frames[i].cmds);
+		xfree(g->frames[i].verts);
+		xfree(g->frames[i].inds);
+	}
+	if(g->cond)
+		SDL_DestroyCond(g->cond);
+	if(g->mtx)
+		SDL_DestroyMutex(g->mtx);
 	SDL_DestroyRenderer(g->rend);
 	SDL_DestroyWindow(g->win);
 	TTF_Quit();
@@ -62,72 +219,547 @@ Point gfxdims(const Gfx *g){
 	return (Point){ w, h };
 }
 
+typedef struct Run Run;
+struct Run{
+	Gfx *g;
+	int (*fn)(void *);
+	void *arg;
+};
+
+int gfxrun(Gfx *g, int (*fn)(void *), void *arg){
+	if(!g->mtx)
+		g->mtx = SDL_CreateMutex();
+	if(!g->cond)
+		g->cond = SDL_CreateCond();
+	if(!g->mtx || !g->cond)
+		return fn(arg);
+
+	Run r = { g, fn, arg };
+	g->threaded = true;
+	g->done = false;
+	SDL_Thread *t = SDL_CreateThread(simthrd, "sim", &r);
+	if(!t){
+		g->threaded = false;
+		return fn(arg);
+	}
+
+	for(;;){
+		SDL_PumpEvents();
+
+		SDL_LockMutex(g->mtx);
+		if(!g->ready && !g->callfn && !g->done)
+			SDL_CondWaitTimeout(g->cond, g->mtx, Pumptm);
+		void (*call)(void *) = g->callfn;
+		void *callarg = g->callarg;
+		Frame *f = g->ready ? g->front : NULL;
+		_Bool done = g->done;
+		SDL_UnlockMutex(g->mtx);
+
+		if(call){
+			call(callarg);
+			SDL_LockMutex(g->mtx);
+			g->callfn = NULL;
+			SDL_CondBroadcast(g->cond);
+			SDL_UnlockMutex(g->mtx);
+		}
+		if(f){
+			framereplay(g, f);
+			// The next frame can be handed over while this one
+			// waits for the display.
+			SDL_LockMutex(g->mtx);
+			g->ready = false;
+			SDL_CondBroadcast(g->cond);
+			SDL_UnlockMutex(g->mtx);
+			SDL_RenderPresent(g->rend);
+		}
+		if(done && !call && !f)
+			break;
+	}
+
+	int ret;
+	SDL_WaitThread(t, &ret);
+	g->threaded = false;
+	// Images freed after the last flip are released now.
+	framereplay(g, g->back);
+	return ret;
+}
+
+static int simthrd(void *p){
+	Run *r = p;
+	int ret = r->fn(r->arg);
+
+	SDL_LockMutex(r->g->mtx);
+	r->g->done = true;
+	SDL_CondBroadcast(r->g->cond);
+	SDL_UnlockMutex(r->g->mtx);
+	return ret;
+}
+
+_Bool gfxthreaded(void){
+	return gfx.threaded;
+}
+
+/* Called by pollevent when the renderer loses its targets' contents. */
+void gfxreset(void){
+	gfx.resets++;
+}
+
+unsigned long gfxresets(Gfx *g){
+	return g->resets;
+}
+
+/* Runs fn(arg) on the thread that owns the renderer, waiting for it
+ * to finish. */
+static void rendercall(Gfx *g, void (*fn)(void *), void *arg){
+	if(!g->threaded){
+		fn(arg);
+		return;
+	}
+	SDL_LockMutex(g->mtx);
+	g->callfn = fn;
+	g->callarg = arg;
+	SDL_CondBroadcast(g->cond);
+	while(g->callfn)
+		SDL_CondWait(g->cond, g->mtx);
+	SDL_UnlockMutex(g->mtx);
+}
+
 void gfxflip(Gfx *g){
-	SDL_RenderPresent(g->rend);
+	gfxflush(g);
+	if(!g->threaded){
+		SDL_RenderPresent(g->rend);
+		return;
+	}
+	SDL_LockMutex(g->mtx);
+	while(g->ready)
+		SDL_CondWait(g->cond, g->mtx);
+	Frame *f = g->front;
+	g->front = g->back;
+	g->back = f;
+	g->ready = true;
+	SDL_CondBroadcast(g->cond);
+	SDL_UnlockMutex(g->mtx);
+}
+
+static void record(Gfx *g, Cmd c){
+	Frame *f = g->back;
+	if(f->ncmds == f->szcmds){
+		f->szcmds = f->szcmds ? f->szcmds * 2 : 256;
+		f->cmds = xrealloc(f->cmds, f->szcmds * sizeof(*f->cmds));
+	}
+	f->cmds[f->ncmds++] = c;
+	if(!g->threaded)
+		framereplay(g, f);
+}
+
+/* Executes the frame's commands and empties it. */
+static void framereplay(Gfx *g, Frame *f){
+	for(int i = 0; i < f->ncmds; i++)
+		cmdexec(g, f, &f->cmds[i]);
+	f->ncmds = 0;
+	f->nverts = 0;
+	f->ninds = 0;
 }
 
 static void rendcolor(Gfx *g, Color c){
 	SDL_SetRenderDrawColor(g->rend, c.r, c.g, c.b, c.a);
 }
 
+/* Draws a Cgeom's quads.  Every quad is an axis-aligned rectangle
+ * with its corners in the order that geomquads's indices expect, so
+ * without SDL_RenderGeometry each can be drawn from its first and
+ * third vertices. */
+static void quadsdraw(Gfx *g, Frame *f, Cmd *c){
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	SDL_RenderGeometry(g->rend, c->tex, f->verts + c->vert, 4 * c->n,
+		f->inds + c->ind, 6 * c->n);
+#else
+	int tw = 0, th = 0;
+	if(c->tex)
+		SDL_QueryTexture(c->tex, NULL, NULL, &tw, &th);
+	Vert *v = f->verts + c->vert;
+	for(int i = 0; i < c->n; i++, v += 4){
+		SDL_Rect d = {
+			v[0].position.x, v[0].position.y,
+			v[2].position.x - v[0].position.x,
+			v[2].position.y - v[0].position.y,
+		};
+		if(!c->tex){
+			SDL_Color k = v[0].color;
+			rendcolor(g, (Color){ k.r, k.g, k.b, k.a });
+			SDL_RenderFillRect(g->rend, &d);
+			continue;
+		}
+		// Texture coordinates came from whole texels, so rounding
+		// recovers them.
+		int x0 = v[0].tex_coord.x * tw + 0.5, y0 = v[0].tex_coord.y * th + 0.5;
+		int x1 = v[2].tex_coord.x * tw + 0.5, y1 = v[2].tex_coord.y * th + 0.5;
+		SDL_Rect s = { x0, y0, x1 - x0, y1 - y0 };
+		SDL_RenderCopy(g->rend, c->tex, &s, &d);
+	}
+#endif
+}
+
+static void cmdexec(Gfx *g, Frame *f, Cmd *c){
+	SDL_Texture *t;
+	SDL_BlendMode mode;
+
+	switch(c->op){
+	case Cclear:
+		rendcolor(g, c->c);
+		SDL_RenderClear(g->rend);
+		break;
+	case Cpoint:
+		rendcolor(g, c->c);
+		SDL_RenderDrawPoint(g->rend, c->r.x, c->r.y);
+		break;
+	case Cfill:
+		rendcolor(g, c->c);
+		SDL_RenderFillRect(g->rend, &c->r);
+		break;
+	case Crect:
+		rendcolor(g, c->c);
+		SDL_RenderDrawRect(g->rend, &c->r);
+		break;
+	case Cgeom:
+		quadsdraw(g, f, c);
+		break;
+	case Ctext:
+		t = SDL_CreateTextureFromSurface(g->rend, c->srf);
+		if(t){
+			SDL_RenderCopy(g->rend, t, NULL, &c->r);
+			SDL_DestroyTexture(t);
+		}
+		SDL_FreeSurface(c->srf);
+		break;
+	case Ctarget:
+		SDL_SetRenderTarget(g->rend, c->tex);
+		break;
+	case Csetpx:
+		SDL_UpdateTexture(c->tex, &c->r, c->px, c->pitch);
+		xfree(c->px);
+		break;
+	case Cfree:
+		imgrelease(c->img);
+		xfree(c->img);
+		break;
+	case Ccopy:
+		SDL_GetTextureBlendMode(c->tex, &mode);
+		SDL_SetTextureBlendMode(c->tex, SDL_BLENDMODE_NONE);
+		SDL_RenderCopy(g->rend, c->tex, &c->src, &c->r);
+		SDL_SetTextureBlendMode(c->tex, mode);
+		break;
+	}
+}
+
 void gfxclear(Gfx *g, Color c){
-	rendcolor(g, c);
-	SDL_RenderClear(g->rend);
+	gfxflush(g);
+	record(g, (Cmd){ .op = Cclear, .c = c });
 }
 
 void gfxdrawpoint(Gfx *g, Point p, Color c){
-	rendcolor(g, c);
-	SDL_RenderDrawPoint(g->rend, p.x, p.y);
+	gfxflush(g);
+	record(g, (Cmd){ .op = Cpoint, .c = c, .r = { p.x, p.y } });
 }
 
 void gfxfillrect(Gfx *g, Rect r, Color c){
 	SDL_Rect sr = { r.a.x, r.a.y, r.b.x - r.a.x, r.b.y - r.a.y };
-	rendcolor(g, c);
-	SDL_RenderFillRect(g->rend, &sr);
+	gfxflush(g);
+	record(g, (Cmd){ .op = Cfill, .c = c, .r = sr });
+}
+
+void gfxfillrects(Gfx *g, Rect *rs, int n, Color c){
+	fillrects(g, rs, n, c, (Point){ 0, 0 });
+}
+
+/* The rectangles are drawn as one run of colored quads, offset by
+ * off. */
+static void fillrects(Gfx *g, Rect *rs, int n, Color c, Point off){
+	if(n <= 0)
+		return;
+	gfxflush(g);
+	Cmd cmd = { .op = Cgeom, .tex = NULL };
+	Vert *v = geomquads(g->back, n, &cmd);
+	SDL_Color sc = { c.r, c.g, c.b, c.a };
+	for(int i = 0; i < n; i++, v += 4){
+		Point a = vecadd(rs[i].a, off), b = vecadd(rs[i].b, off);
+		// Rounded as SDL_RenderFillRect's int coordinates are.
+		float x0 = (int) a.x, y0 = (int) a.y;
+		float x1 = x0 + (int) (b.x - a.x), y1 = y0 + (int) (b.y - a.y);
+		v[0] = (Vert){ { x0, y0 }, sc };
+		v[1] = (Vert){ { x1, y0 }, sc };
+		v[2] = (Vert){ { x1, y1 }, sc };
+		v[3] = (Vert){ { x0, y1 }, sc };
+	}
+	record(g, cmd);
 }
 
 void gfxdrawrect(Gfx *g, Rect r, Color c){
 	SDL_Rect sr = { r.a.x, r.a.y, r.b.x - r.a.x, r.b.y - r.a.y };
-	rendcolor(g, c);
-	SDL_RenderDrawRect(g->rend, &sr);
+	gfxflush(g);
+	record(g, (Cmd){ .op = Crect, .c = c, .r = sr });
 }
 
-struct Img{
-	SDL_Texture *tex;
+Img *imgnew(const char *path){
+	return imgupload(imgdecode(path));
+}
+
+struct Imgdata{
+	SDL_Surface *srf;
 };
 
-Img *imgnew(const char *path){
+Imgdata *imgdecode(const char *path){
 	SDL_Surface *s = IMG_Load(path);
 	if(!s)
 		return NULL;
+	Imgdata *d = xalloc(1, sizeof(*d));
+	d->srf = s;
+	return d;
+}
 
-	SDL_Texture *t = SDL_CreateTextureFromSurface(gfx.rend, s);
-	SDL_FreeSurface(s);
-	if(!t)
+void imgdatafree(Imgdata *d){
+	if(!d)
+		return;
+	SDL_FreeSurface(d->srf);
+	xfree(d);
+}
+
+Img *imgupload(Imgdata *d){
+	if(!d)
+		return NULL;
+	Texreq r = { .srf = d->srf };
+	Img *i = texnew(&r);
+	imgdatafree(d);
+	return i;
+}
+
+static Img *texnew(Texreq *r){
+	rendercall(&gfx, texcreate, r);
+	if(!r->tex)
 		return NULL;
 
 	Img *i = xalloc(1, sizeof(*i));
-	i->tex = t;
+	i->tex = r->tex;
+	i->texw = i->w = r->w;
+	i->texh = i->h = r->h;
 	return i;
 }
 
+static SDL_Texture *srf2tex(SDL_Surface *s){
+	Texreq r = { .srf = s };
+	rendercall(&gfx, texcreate, &r);
+	return r.tex;
+}
+
+/* Called by rendercall. */
+static void texdestroy(void *t){
+	SDL_DestroyTexture(t);
+}
+
+/* Called by rendercall. */
+static void texcreate(void *p){
+	Texreq *r = p;
+	SDL_Texture *t;
+
+	if(r->srf){
+		t = SDL_CreateTextureFromSurface(gfx.rend, r->srf);
+	}else if(r->access == SDL_TEXTUREACCESS_TARGET && !SDL_RenderTargetSupported(gfx.rend)){
+		seterrstr("Render targets are not supported");
+		t = NULL;
+	}else{
+		t = SDL_CreateTexture(gfx.rend, r->fmt, r->access, r->w, r->h);
+	}
+	if(!t)
+		return;
+
+	Uint32 fmt;
+	int access;
+	if(SDL_QueryTexture(t, &fmt, &access, &r->w, &r->h) < 0){
+		SDL_DestroyTexture(t);
+		return;
+	}
+	if(r->blend)
+		SDL_SetTextureBlendMode(t, SDL_BLENDMODE_BLEND);
+	r->tex = t;
+}
+
+_Bool imgatlas(Img *imgs[], Imgdata *data[], int n){
+	SDL_Surface *srfs[n];
+	SDL_Rect locs[n];
+
+	for(int i = 0; i < n; i++){
+		imgs[i] = NULL;
+		srfs[i] = data[i]->srf;
+		xfree(data[i]);
+	}
+
+	int h = atlaspack(srfs, n, locs);
+	SDL_Surface *all = SDL_CreateRGBSurfaceWithFormat(0, Atlasw, h, 32, SDL_PIXELFORMAT_RGBA32);
+	Atlas *a = xalloc(1, sizeof(*a));
+	if(all){
+		for(int i = 0; i < n; i++){
+			if(locs[i].w == 0)
+				continue;
+			SDL_SetSurfaceBlendMode(srfs[i], SDL_BLENDMODE_NONE);
+			SDL_BlitSurface(srfs[i], NULL, all, &locs[i]);
+		}
+		a->tex = srf2tex(all);
+		SDL_FreeSurface(all);
+	}
+
+	_Bool ok = true;
+	for(int i = 0; i < n; i++){
+		if(a->tex && locs[i].w > 0){
+			Img *img = xalloc(1, sizeof(*img));
+			*img = (Img){ a->tex, Atlasw, h, locs[i].x, locs[i].y, locs[i].w, locs[i].h, a };
+			a->refs++;
+			imgs[i] = img;
+		}else{
+			// Didn't fit, so it gets a texture of its own.
+			Texreq r = { .srf = srfs[i] };
+			imgs[i] = texnew(&r);
+			ok = ok && imgs[i];
+		}
+		SDL_FreeSurface(srfs[i]);
+	}
+	if(a->refs == 0){
+		// Nothing has drawn it, so it can go right away.
+		if(a->tex)
+			rendercall(&gfx, texdestroy, a->tex);
+		xfree(a);
+	}
+	return ok;
+}
+
+/* Shelf-pack the surfaces, tallest first, into an Atlasw-wide atlas,
+ * returning its height.  Surfaces that don't fit get a zero-sized
+ * loc. */
+static int atlaspack(SDL_Surface *srfs[], int n, SDL_Rect locs[]){
+	int ord[n];
+	for(int i = 0; i < n; i++)
+		ord[i] = i;
+	for(int i = 1; i < n; i++){
+		int o = ord[i], j;
+		for(j = i; j > 0 && srfs[ord[j-1]]->h < srfs[o]->h; j--)
+			ord[j] = ord[j-1];
+		ord[j] = o;
+	}
+
+	int x = 0, y = 0, shelfh = 0;
+	for(int i = 0; i < n; i++){
+		SDL_Surface *s = srfs[ord[i]];
+		int w = s->w + Atlaspad, h = s->h + Atlaspad;
+		if(x + w > Atlasw){
+			x = 0;
+			y += shelfh;
+			shelfh = 0;
+		}
+		if(w > Atlasw || y + h > Atlasmaxh){
+			locs[ord[i]] = (SDL_Rect){0};
+			continue;
+		}
+		locs[ord[i]] = (SDL_Rect){ x, y, s->w, s->h };
+		x += w;
+		if(h > shelfh)
+			shelfh = h;
+	}
+	return y + shelfh > 0 ? y + shelfh : 1;
+}
+
+Img *imgtarget(Gfx *g, int w, int h){
+	Texreq r = { NULL, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h, true };
+	return texnew(&r);
+}
+
+Img *imgstream(Gfx *g, int w, int h){
+	Texreq r = { NULL, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, w, h, true };
+	return texnew(&r);
+}
+
+void imgsetpx(Img *img, const Color *px){
+	imgsetrows(img, 0, img->texh, px);
+}
+
+void imgsetrows(Img *img, int y, int n, const Color *px){
+	// Queued sprites should be drawn with the old pixels.
+	gfxflush(&gfx);
+	size_t sz = (size_t)img->texw * n * sizeof(*px);
+	Color *cp = xalloc(1, sz);
+	memcpy(cp, px, sz);
+	SDL_Rect r = { 0, y, img->texw, n };
+	record(&gfx, (Cmd){ .op = Csetpx, .r = r, .tex = img->tex, .px = cp, .pitch = img->texw * sizeof(*px) });
+}
+
+void gfxtarget(Gfx *g, Img *img){
+	gfxflush(g);
+	record(g, (Cmd){ .op = Ctarget, .tex = img ? img->tex : NULL });
+}
+
+/* The image is released after the commands recorded before it, which
+ * may still refer to its texture. */
 void imgfree(Img *img){
-	SDL_DestroyTexture(img->tex);
-	xfree(img);
+	gfxflush(&gfx);
+	record(&gfx, (Cmd){ .op = Cfree, .img = img });
+}
+
+_Bool imgreload(Img *img, const char *path){
+	Imgdata *d = imgdecode(path);
+	if(!d)
+		return false;
+	Texreq r = { .srf = d->srf };
+	Img *i = texnew(&r);
+	imgdatafree(d);
+	if(!i)
+		return false;
+
+	// The new pixels may not fit the image's atlas region, so it
+	// gets a texture of its own.  The old one is freed with a
+	// copy of the image.
+	Img *old = xalloc(1, sizeof(*old));
+	*old = *img;
+	*img = *i;
+	xfree(i);
+	imgfree(old);
+	return true;
+}
+
+/* Releases the image's texture.  Only called by replaying a frame. */
+static void imgrelease(Img *img){
+	if(!img->atlas){
+		SDL_DestroyTexture(img->tex);
+	}else if(--img->atlas->refs == 0){
+		SDL_DestroyTexture(img->tex);
+		xfree(img->atlas);
+	}
 }
 
 Point imgdims(const Img *img){
-	Uint32 fmt;
-	int access, w, h;
-	if (SDL_QueryTexture(img->tex, &fmt, &access, &w, &h) < 0)
-		return (Point) { -1, -1 };
-	return (Point){ w, h };
+	return (Point){ img->w, img->h };
+}
+
+unsigned long imgbytes(const Img *img){
+	if(img->atlas)
+		return (unsigned long)img->w * img->h * 4;
+	return (unsigned long)img->texw * img->texh * 4;
 }
 
 void imgdraw(Gfx *g, Img *img, Point p){
-	Point wh = imgdims(img);
-	SDL_Rect r = { p.x, p.y, wh.x, wh.y };
-	SDL_RenderCopy(g->rend, img->tex, 0, &r);
+	SDL_Rect src = { img->x, img->y, img->w, img->h };
+	SDL_Rect dst = { p.x, p.y, img->w, img->h };
+	spritedraw(g, img, src, dst);
+}
+
+void imgcopy(Gfx *g, Img *img, Point p){
+	SDL_Rect src = { img->x, img->y, img->w, img->h };
+	SDL_Rect dst = { p.x, p.y, img->w, img->h };
+	gfxflush(g);
+	record(g, (Cmd){ .op = Ccopy, .tex = img->tex, .src = src, .r = dst });
+}
+
+void imgdrawscaled(Gfx *g, Img *img, Rect r){
+	SDL_Rect src = { img->x, img->y, img->w, img->h };
+	SDL_Rect dst = { r.a.x, r.a.y, r.b.x - r.a.x, r.b.y - r.a.y };
+	spritedraw(g, img, src, dst);
 }
 
 void imgdrawreg(Gfx *g, Img *img, Rect clip, Point p){
@@ -135,7 +767,125 @@ void imgdrawreg(Gfx *g, Img *img, Rect clip, Point p){
 	double h = clip.b.y - clip.a.y;
 	SDL_Rect src = { clip.a.x, clip.a.y, w, h };
 	SDL_Rect dst = { p.x, p.y, w, h };
-	SDL_RenderCopy(g->rend, img->tex, &src, &dst);
+
+	// Clip to the image, as SDL_RenderCopy would to a whole
+	// texture, so that an atlas image's neighbors don't show.
+	if(src.x < 0){
+		dst.x -= src.x;
+		src.w += src.x;
+		dst.w = src.w;
+		src.x = 0;
+	}
+	if(src.y < 0){
+		dst.y -= src.y;
+		src.h += src.y;
+		dst.h = src.h;
+		src.y = 0;
+	}
+	if(src.x + src.w > img->w)
+		dst.w = src.w = img->w - src.x;
+	if(src.y + src.h > img->h)
+		dst.h = src.h = img->h - src.y;
+	if(src.w <= 0 || src.h <= 0)
+		return;
+
+	src.x += img->x;
+	src.y += img->y;
+	spritedraw(g, img, src, dst);
+}
+
+static void spritedraw(Gfx *g, Img *img, SDL_Rect src, SDL_Rect dst){
+	if(g->nsprs == g->szsprs){
+		g->szsprs = g->szsprs ? g->szsprs * 2 : 256;
+		g->sprs = xrealloc(g->sprs, g->szsprs * sizeof(*g->sprs));
+	}
+	int i = g->nsprs++;
+	g->sprs[i] = (Sprite){ src, dst, -1 };
+
+	for(int j = g->nbats - 1; j >= 0; j--){
+		Batch *b = &g->bats[j];
+		if(b->tex == img->tex){
+			g->sprs[b->last].next = i;
+			b->last = i;
+			b->n++;
+			b->bbox = rectunion(b->bbox, dst);
+			return;
+		}
+		if(rectsoverlap(b->bbox, dst))
+			break;
+	}
+
+	if(g->nbats == g->szbats){
+		g->szbats = g->szbats ? g->szbats * 2 : 32;
+		g->bats = xrealloc(g->bats, g->szbats * sizeof(*g->bats));
+	}
+	g->bats[g->nbats++] = (Batch){ img->tex, img->texw, img->texh, dst, i, i, 1 };
+}
+
+/* Submit all queued sprites. */
+static void gfxflush(Gfx *g){
+	for(int i = 0; i < g->nbats; i++)
+		batchsubmit(g, &g->bats[i]);
+	g->nsprs = 0;
+	g->nbats = 0;
+}
+
+static void batchsubmit(Gfx *g, Batch *b){
+	Cmd c = { .op = Cgeom, .tex = b->tex };
+	Vert *v = geomquads(g->back, b->n, &c);
+	SDL_Color white = { 255, 255, 255, 255 };
+	for(int i = b->first, k = 0; i >= 0; i = g->sprs[i].next, k++){
+		SDL_Rect s = g->sprs[i].src, d = g->sprs[i].dst;
+		float u0 = (float) s.x / b->texw, u1 = (float) (s.x + s.w) / b->texw;
+		float v0 = (float) s.y / b->texh, v1 = (float) (s.y + s.h) / b->texh;
+		v[0] = (Vert){ { d.x, d.y }, white, { u0, v0 } };
+		v[1] = (Vert){ { d.x + d.w, d.y }, white, { u1, v0 } };
+		v[2] = (Vert){ { d.x + d.w, d.y + d.h }, white, { u1, v1 } };
+		v[3] = (Vert){ { d.x, d.y + d.h }, white, { u0, v1 } };
+		v += 4;
+	}
+	record(g, c);
+}
+
+/* Adds n quads to the frame's geometry, setting c's vertices, indices
+ * and count, and returns their 4n vertices for the caller to fill. */
+static Vert *geomquads(Frame *f, int n, Cmd *c){
+	if(f->nverts + 4 * n > f->szverts){
+		f->szverts = (f->nverts + 4 * n) * 2;
+		f->verts = xrealloc(f->verts, f->szverts * sizeof(*f->verts));
+	}
+	if(f->ninds + 6 * n > f->szinds){
+		f->szinds = (f->ninds + 6 * n) * 2;
+		f->inds = xrealloc(f->inds, f->szinds * sizeof(*f->inds));
+	}
+
+	c->vert = f->nverts;
+	c->ind = f->ninds;
+	c->n = n;
+	int *ind = f->inds + f->ninds;
+	for(int k = 0; k < n; k++){
+		int base = 4 * k;
+		int quad[] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+		memcpy(ind, quad, sizeof(quad));
+		ind += 6;
+	}
+	Vert *v = f->verts + f->nverts;
+	f->nverts += 4 * n;
+	f->ninds += 6 * n;
+	return v;
+}
+
+static _Bool rectsoverlap(SDL_Rect a, SDL_Rect b){
+	return a.x < b.x + b.w && b.x < a.x + a.w
+		&& a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+static SDL_Rect rectunion(SDL_Rect a, SDL_Rect b){
+	int x0 = a.x < b.x ? a.x : b.x;
+	int y0 = a.y < b.y ? a.y : b.y;
+	int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+	int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+	return (SDL_Rect){ x0, y0, x1 - x0, y1 - y0 };
 }
 
 struct Txt{
@@ -158,6 +908,22 @@ void txtfree(Txt *t){
 	xfree(t);
 }
 
+_Bool txtreload(Txt *t, const char *font, int sz){
+	TTF_Font *f = TTF_OpenFont(font, sz);
+	if(!f)
+		return false;
+	TTF_CloseFont(t->font);
+	t->font = f;
+	return true;
+}
+
+/* SDL_ttf caches a coverage bitmap per rendered glyph, so estimate
+ * the cache for the printable ASCII characters. */
+unsigned long txtbytes(const Txt *t){
+	unsigned long h = TTF_FontHeight(t->font);
+	return sizeof(*t) + h * h * 95;
+}
+
 Point txtdims(const Txt *t, const char *fmt, ...){
 	va_list ap;
 
@@ -185,21 +951,32 @@ Img *txt2img(Gfx *g, Txt *t, const char *fmt, ...){
 	va_list ap;
 
 	va_start(ap, fmt);
-	Img *i = vtxt2img(g, t, fmt, ap);
+	SDL_Surface *srf = vtxtsrf(t, fmt, ap);
 	va_end(ap);
+	if (!srf)
+		return NULL;
+
+	Texreq r = { .srf = srf };
+	Img *i = texnew(&r);
+	SDL_FreeSurface(srf);
 	return i;
 }
 
+/* The text is rendered now, but its texture is made and freed when
+ * the frame is replayed. */
 Point txtdraw(Gfx *g, Txt *t, Point p, const char *fmt, ...)
 {
 	va_list ap;
 
 	va_start(ap, fmt);
-	Img *i = vtxt2img(g, t, fmt, ap);
+	SDL_Surface *srf = vtxtsrf(t, fmt, ap);
 	va_end(ap);
 
-	imgdraw(g, i, p);
-	imgfree(i);
+	if (srf) {
+		gfxflush(g);
+		SDL_Rect dst = { p.x, p.y, srf->w, srf->h };
+		record(g, (Cmd){ .op = Ctext, .r = dst, .srf = srf });
+	}
 
 	va_start(ap, fmt);
 	Point ret = (Point){ p.x + vtxtdims(t, fmt, ap).x, p.y };
@@ -208,23 +985,12 @@ Point txtdraw(Gfx *g, Txt *t, Point p, const char *fmt, ...)
 	return ret;
 }
 
-static Img *vtxt2img(Gfx *g, Txt *t, const char *fmt, va_list ap)
+static SDL_Surface *vtxtsrf(Txt *t, const char *fmt, va_list ap)
 {
 	char s[Bufsize + 1];
 	vsnprintf(s, Bufsize + 1, fmt, ap);
 
-	SDL_Surface *srf = TTF_RenderUTF8_Blended(t->font, s, c2s(t->color));
-	if (!srf)
-		return NULL;
-
-	SDL_Texture *tex = SDL_CreateTextureFromSurface(g->rend, srf);
-	SDL_FreeSurface(srf);
-	if (!tex)
-		return NULL;
-
-	Img *i = xalloc(1, sizeof(*i));
-	i->tex = tex;
-	return i;
+	return TTF_RenderUTF8_Blended(t->font, s, c2s(t->color));
 }
 
 void camreset(Gfx *g){
@@ -252,11 +1018,21 @@ void camfillrect(Gfx *g, Rect r, Color c){
 	gfxfillrect(g, r, c);
 }
 
+void camfillrects(Gfx *g, Rect *rs, int n, Color c){
+	fillrects(g, rs, n, c, g->tr);
+}
+
 void camdrawimg(Gfx *g, Img *i, Point p){
 	p = vecadd(p, g->tr);
 	imgdraw(g, i, p);
 }
 
+void camdrawscaled(Gfx *g, Img *i, Rect r){
+	r.a = vecadd(r.a, g->tr);
+	r.b = vecadd(r.b, g->tr);
+	imgdrawscaled(g, i, r);
+}
+
 void camdrawreg(Gfx *g, Img *i, Rect c, Point p){
 	p = vecadd(p, g->tr);
 	imgdrawreg(g, i, c, p);
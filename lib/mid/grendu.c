@@ -16,7 +16,7 @@ Info grenduinfo = {
 		.item = { ItemSilver, ItemGold },
 		.prob = { 85, 15 }
 	},
-	.death = EnemySplat
+	.death = PartSplat
 };
 
 _Bool grenduinit(Enemy *e, int x, int y){
@@ -32,6 +32,10 @@ void grenduupdate(Enemy *e, Player *p, Zone *z){
 	enemygenupdate(e, p, z, &grenduinfo);
 }
 
+void grendutouch(Enemy *e, Player *p, Zone *z, int hits){
+	enemygentouch(e, p, z, &grenduinfo, hits);
+}
+
 void grendudraw(Enemy *e, Gfx *g){
 	if(e->iframes % 4 != 0)
 		return;
@@ -47,7 +51,7 @@ void grendudraw(Enemy *e, Gfx *g){
 			{ 32, 0 },
 			{ 64, 32 }
 		};
-	camdrawreg(g, grenduimg, clip, e->body.bbox.a);
+	camdrawreg(g, grenduimg, clip, bodydrawpt(&e->body));
 }
 
 _Bool grenduscan(char *buf, Enemy *e){
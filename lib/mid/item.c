@@ -8,7 +8,7 @@ typedef struct ItemOps ItemOps;
 struct ItemOps{
 	char *name;
 	char *animname;
-	void (*update)(Item*,Player*,Zone*);
+	void (*pickup)(Item*,Player*,Zone*);
 	void (*eat)(Invit*,Player*,Zone*);
 	Anim anim;
 	int stats[StatMax];
@@ -16,14 +16,14 @@ struct ItemOps{
 	ArmorSetID set;
 };
 
-static void statupupdate(Item*,Player*,Zone*);
-static void copperupdate(Item*,Player*,Zone*);
-static void healthupdate(Item *, Player *, Zone *);
-static void silverupdate(Item*,Player*,Zone*);
-static void goldupdate(Item*,Player*,Zone*);
-static void carrotupdate(Item*,Player*,Zone*);
-static void tophatupdate(Item*,Player*,Zone*);
-static void silverswdupdate(Item*,Player*,Zone*);
+static void statuppickup(Item*,Player*,Zone*);
+static void copperpickup(Item*,Player*,Zone*);
+static void healthpickup(Item *, Player *, Zone *);
+static void silverpickup(Item*,Player*,Zone*);
+static void goldpickup(Item*,Player*,Zone*);
+static void carrotpickup(Item*,Player*,Zone*);
+static void tophatpickup(Item*,Player*,Zone*);
+static void silverswdpickup(Item*,Player*,Zone*);
 static void hamcaneat(Invit*,Player*,Zone*);
 
 static Sfx *goldgrab;
@@ -33,67 +33,67 @@ static ItemOps ops[] = {
 	[ItemStatup] = {
 		"Orb of Power",
 		"img/items.png",
-		statupupdate,
+		statuppickup,
 		NULL,
-		{ .row = 0, .len = 2, .delay = 1200/Ticktm, .w = 32, .h = 32, .d = 1200/Ticktm }
+		{ .row = 0, .len = 2, .delay = 1200/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemCopper] = {
 		"c",
 		"img/items.png",
-		copperupdate,
+		copperpickup,
 		NULL,
-		{ .row = 1, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32, .d = 150/Ticktm }
+		{ .row = 1, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemHealth] = {
 		"Broccoli",
 		"img/items.png",
-		healthupdate,
+		healthpickup,
 		NULL,
-		{ .row = 2, .len = 2, .delay = 600/Ticktm, .w = 32, .h = 32, .d = 600/Ticktm }
+		{ .row = 2, .len = 2, .delay = 600/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemSilver] = {
 		"s",
 		"img/items.png",
-		silverupdate,
+		silverpickup,
 		NULL,
-		{ .row = 3, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32, .d = 150/Ticktm }
+		{ .row = 3, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemGold] = {
 		"g",
 		"img/items.png",
-		goldupdate,
+		goldpickup,
 		NULL,
-		{ .row = 4, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32, .d = 150/Ticktm }
+		{ .row = 4, .len = 8, .delay = 150/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemCarrot] = {
 		"Carrot",
 		"img/items.png",
-		carrotupdate,
+		carrotpickup,
 		NULL,
-		{ .row = 5, .len = 2, .delay = 600/Ticktm, .w = 32, .h = 32, .d = 600/Ticktm }
+		{ .row = 5, .len = 2, .delay = 600/Ticktm, .w = 32, .h = 32 }
 	},
 	[ItemHamCan] = {
 		"Ham Can",
 		"img/items.png",
-		statupupdate,
+		statuppickup,
 		hamcaneat,
-		{ .row = 9, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 }
+		{ .row = 9, .len = 1, .delay = 1, .w = 32, .h = 32 }
 	},
 	[ItemTopHat] = {
 		"Top Hat",
 		"img/items.png",
-		tophatupdate,
+		tophatpickup,
 		NULL,
-		{.row = 6, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{.row = 6, .len = 1, .delay = 1, .w = 32, .h = 32},
 		.stats = { 0, 5, 0 },
 		.loc = EqpHead
 	},
 	[ItemIronHelm] = {
 		"Iron Helm",
 		"img/iron.png",
-		tophatupdate,
+		tophatpickup,
 		NULL,
-		{.row = 0, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{.row = 0, .len = 1, .delay = 1, .w = 32, .h = 32},
 		.stats = { [StatHp] = 1 },
 		.loc = EqpHead,
 		.set = ArmorSetIron
@@ -101,9 +101,9 @@ static ItemOps ops[] = {
 	[ItemIronGlove] = {
 		"Iron Gloves",
 		"img/iron.png",
-		tophatupdate,
+		tophatpickup,
 		NULL,
-		{.row = 2, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{.row = 2, .len = 1, .delay = 1, .w = 32, .h = 32},
 		.stats = { [StatHp] = 1 },
 		.loc = EqpArms,
 		.set = ArmorSetIron
@@ -111,9 +111,9 @@ static ItemOps ops[] = {
 	[ItemIronBody] = {
 		"Iron Plate",
 		"img/iron.png",
-		tophatupdate,
+		tophatpickup,
 		NULL,
-		{.row = 1, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{.row = 1, .len = 1, .delay = 1, .w = 32, .h = 32},
 		.stats = { [StatHp] = 3 },
 		.loc = EqpBody,
 		.set = ArmorSetIron
@@ -121,9 +121,9 @@ static ItemOps ops[] = {
 	[ItemIronBoot] = {
 		"Iron Boots",
 		"img/iron.png",
-		tophatupdate,
+		tophatpickup,
 		NULL,
-		{.row = 3, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{.row = 3, .len = 1, .delay = 1, .w = 32, .h = 32},
 		.stats = { [StatHp] = 1, [StatDex] = -1 },
 		.loc = EqpLegs,
 		.set = ArmorSetIron
@@ -131,27 +131,27 @@ static ItemOps ops[] = {
 	[ItemSilverSwd] = {
 		"Silver Sword",
 		"img/items.png",
-		silverswdupdate,
+		silverswdpickup,
 		NULL,
-		{ .row = 7, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{ .row = 7, .len = 1, .delay = 1, .w = 32, .h = 32 },
 		.stats = { 0, 0, 1 },
 		.loc = EqpWep
 	},
 	[ItemBroadSwd] = {
 		"Lady Sword",
 		"img/items.png",
-		silverswdupdate,
+		silverswdpickup,
 		NULL,
-		{ .row = 8, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1},
+		{ .row = 8, .len = 1, .delay = 1, .w = 32, .h = 32 },
 		.stats = { 0, 0, 3 },
 		.loc = EqpWep
 	},
 	[ItemWindSwd] = {
 		"Kaze",
 		"img/items.png",
-		silverswdupdate,
+		silverswdpickup,
 		NULL,
-		{ .row = 10, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 },
+		{ .row = 10, .len = 1, .delay = 1, .w = 32, .h = 32 },
 		.stats = { 0, 1, 2 },
 		.loc = EqpWep
 	},
@@ -197,14 +197,14 @@ _Bool itemprint(char *buf, size_t sz, Item *it){
 	return printgeom(buf, sz, "dy", it->id, it->body);
 }
 
-void itemupdateanims(void){
-	for(size_t i = 1; i < sizeof(ops)/sizeof(ops[0]); i++)
-		animupdate(&ops[i].anim);
+void itemupdate(Item *i, Player *p, Zone *z){
+	if(i->id)
+		bodyupdate(&i->body, z->lvl);
 }
 
-void itemupdate(Item *i, Player *p, Zone *l){
+void itempickup(Item *i, Player *p, Zone *z){
 	if(i->id)
-		ops[i->id].update(i, p, l);
+		ops[i->id].pickup(i, p, z);
 }
 
 void itemdraw(Item *i, Gfx *g){
@@ -212,7 +212,7 @@ void itemdraw(Item *i, Gfx *g){
 		return;
 	if(debugging)
 		camfillrect(g, i->body.bbox, (Color){255,0,0,255});
-	camdrawanim(g, &ops[i->id].anim, i->body.bbox.a);
+	camdrawanim(g, &ops[i->id].anim, bodydrawpt(&i->body));
 }
 
 char *itemname(ItemID id){
@@ -245,78 +245,52 @@ _Bool inviteat(Invit *it, Player *p, Zone *z){
 	return 1;
 }
 
-static void statupupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p)) && playertake(p, i)){
+static void statuppickup(Item *i, Player *p, Zone *z){
+	if(playertake(p, i)){
 		sfxplay(gengrab);
 		i->id = ItemNone;
 	}
 }
 
-static void copperupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p))){
-		sfxplay(goldgrab);
-		p->money++;
-		i->id = ItemNone;
-	}
+static void copperpickup(Item *i, Player *p, Zone *z){
+	sfxplay(goldgrab);
+	p->money++;
+	i->id = ItemNone;
 }
 
-static void healthupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p))){
-		sfxplay(gengrab);
-		playerheal(p, 1);
-		i->id = ItemNone;
-	}
+static void healthpickup(Item *i, Player *p, Zone *z){
+	sfxplay(gengrab);
+	playerheal(p, 1);
+	i->id = ItemNone;
 }
 
-static void silverupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p))){
-		sfxplay(goldgrab);
-		p->money += 5;
-		i->id = ItemNone;
-	}
+static void silverpickup(Item *i, Player *p, Zone *z){
+	sfxplay(goldgrab);
+	p->money += 5;
+	i->id = ItemNone;
 }
 
-static void goldupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p))){
-		sfxplay(goldgrab);
-		p->money += 25;
-		i->id = ItemNone;
-	}
+static void goldpickup(Item *i, Player *p, Zone *z){
+	sfxplay(goldgrab);
+	p->money += 25;
+	i->id = ItemNone;
 }
 
-static void carrotupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p))){
-		sfxplay(gengrab);
-		playerheal(p, 5);
-		i->id = ItemNone;
-	}
+static void carrotpickup(Item *i, Player *p, Zone *z){
+	sfxplay(gengrab);
+	playerheal(p, 5);
+	i->id = ItemNone;
 }
 
-static void tophatupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p)) && playertake(p, i)){
+static void tophatpickup(Item *i, Player *p, Zone *z){
+	if(playertake(p, i)){
 		sfxplay(gengrab);
 		i->id = ItemNone;
 	}
 }
 
-static void silverswdupdate(Item *i, Player *p, Zone *z){
-	bodyupdate(&i->body, z->lvl);
-
-	if(isect(i->body.bbox, playerbox(p)) && playertake(p, i)){
+static void silverswdpickup(Item *i, Player *p, Zone *z){
+	if(playertake(p, i)){
 		sfxplay(gengrab);
 		i->id = ItemNone;
 	}
@@ -2,28 +2,48 @@
 
 #include "../../include/mid.h"
 #include <assert.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 #include <math.h>
 
-enum { Blkvis = 1 << 1 };
+/* Mask alpha over blocks that haven't been seen and over seen blocks
+ * at the edge of the unseen. */
+enum { Unseenalpha = 255, Shadealpha = 127 };
+
+/* Version 0 levels have one character per tile.  Version 1 levels
+ * start with a "v1" header field and run-length encode their rows. */
+enum { Lvlvers = 1, Minrun = 3 };
 static const double Grav = 0.5;
 
-static bool tileread(FILE *f, Lvl *l, int x, int y, int z);
+typedef struct Fov Fov;
+struct Fov {
+	Lvl *l;
+	int x, y;
+	int r;	/* radius, or 0 for none */
+	const int *q;	/* the quadrant being scanned */
+};
+
+static bool tilescan(char **rowp, Lvl *l, int y, int z, int vers);
+static void tileinit(Lvl *l, int x, int y, int z, int t);
+static int tilerle(char *buf, Lvl *l, int y, int z);
 static void tiledraw(Gfx *g, int t, Point pt, int l);
 static void tiledrawlyrs(Gfx *g, int t, Point pt, int mn, int mx);
-static bool isshaded(Lvl *l, int t, int x, int y);
+static bool isshaded(Lvl *l, int x, int y);
 static bool isvis(Lvl *l, int x, int y);
-static void shade(Gfx *g, Point p);
+static void maskdraw(Gfx *g, Lvl *l);
+static void maskmark(Lvl *l, int y0, int y1);
+static void maskupdate(Lvl *l);
 static Rect tilebbox(int x, int y);
-static Isect tileisect(int t, int x, int y, Rect r);
+static Isect tileisect(Lvl *l, int x, int y, Rect r);
 static Rect hitzone(Rect a, Point v);
-static void visline(Lvl *l, int x0, int y0, int x1, int y1);
-static bool edge(Lvl *l, int x, int y);
+static void fovscan(Fov *f, int depth, int sn, int sd, int en, int ed);
+static void reveal(Fov *f, int x, int y, int depth, int col);
+static int floordiv(int a, int b);
 static bool blkd(Lvl *l, int x, int y);
 
-static Img *shdimg;
 static Img *tisht[LvlMaxPallets];
 
 enum { Tlayers = 4 };
@@ -38,86 +58,86 @@ struct Tinfo {
 static Tinfo tiles[] = {
 	[' '] = {
 		.ok = true,
-		.anims = { [0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm } },
+		.anims = { [0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 } },
 	},
 	['#'] = {
 		.ok = true,
-		.anims = { [0] = { .row = 1, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 } },
+		.anims = { [0] = { .row = 1, .len = 1, .delay = 1, .w = 32, .h = 32 } },
 		.flags = Tcollide | Topaque
 	},
 	['w'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm  },
-			[2] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32, .d = 300/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[2] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Twater
 	},
 	['>'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 3, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 3, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tbdoor
 	},
 	[')'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 3, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[2] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32, .d = 300/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 3, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[2] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tbdoor | Twater
 	},
 	['<'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[3] = { .row = 4, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[3] = { .row = 4, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tfdoor
 	},
 	['('] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[2] = { .row = 4, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32, .d = 300/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[2] = { .row = 4, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tfdoor | Twater
 	},
 	['d'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 5, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 5, .len = 1, .delay = 1, .w = 32, .h = 32 },
 		},
 		.flags = Tdown
 	},
 	['D'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 5, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 },
-			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32, .d = 300/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 5, .len = 1, .delay = 1, .w = 32, .h = 32 },
+			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tdown | Twater
 	},
 	['u'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 6, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 6, .len = 1, .delay = 1, .w = 32, .h = 32 },
 		},
 		.flags = Tup
 	},
 	['U'] = {
 		.ok = true,
 		.anims = {
-			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32, .d = 400/Ticktm },
-			[1] = { .row = 6, .len = 1, .delay = 1, .w = 32, .h = 32, .d = 1 },
-			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32, .d = 300/Ticktm },
+			[0] = { .row = 0, .len = 4, .delay = 400/Ticktm, .w = 32, .h = 32 },
+			[1] = { .row = 6, .len = 1, .delay = 1, .w = 32, .h = 32 },
+			[3] = { .row = 2, .len = 11, .delay = 300/Ticktm, .w = 32, .h = 32 },
 		},
 		.flags = Tup | Twater
 	},
@@ -134,6 +154,9 @@ static bool istile(int t)
 
 void lvlfree(Lvl *l)
 {
+	if (l->mask)
+		imgfree(l->mask);
+	xfree(l->planes);
 	xfree(l);
 }
 
@@ -144,9 +167,44 @@ Lvl *lvlnew(int d, int w, int h, int z)
 	l->w = w;
 	l->h = h;
 	l->seenz = z;
+	l->pwords = (w * h + 63) / 64;
+	l->planes = xalloc(Nplanes * d * l->pwords, sizeof(*l->planes));
 	return l;
 }
 
+void lvlsettile(Lvl *l, int x, int y, int z, int t)
+{
+	blk(l, x, y, z)->tile = t;
+
+	unsigned int i = y * l->w + x;
+	unsigned long long bit = 1ULL << (i % 64);
+	unsigned int flags = istile(t) ? tiles[t].flags : 0;
+	for (int p = 0; p < Nplanes; p++) {
+		unsigned long long *w = &l->planes[(p * l->d + z) * l->pwords + i / 64];
+		if (flags & 1 << p)
+			*w |= bit;
+		else
+			*w &= ~bit;
+	}
+}
+
+/* Like lvlsettile, but for a block of a new level, whose bits in the
+ * planes are all still clear. */
+static void tileinit(Lvl *l, int x, int y, int z, int t)
+{
+	blk(l, x, y, z)->tile = t;
+
+	unsigned int flags = tiles[t].flags;
+	if (flags == 0)
+		return;
+	unsigned int i = y * l->w + x;
+	unsigned long long bit = 1ULL << (i % 64);
+	for (int p = 0; p < Nplanes; p++) {
+		if (flags & 1 << p)
+			l->planes[(p * l->d + z) * l->pwords + i / 64] |= bit;
+	}
+}
+
 bool lvlinit()
 {
 	tisht[0] = resrcacq(imgs, "img/tiles0.png", NULL);
@@ -154,11 +212,6 @@ bool lvlinit()
 	tisht[1] = resrcacq(imgs, "img/tiles.png", NULL);
 	assert(tisht[1] != NULL);
 
-	if (!shdimg)
-		shdimg = resrcacq(imgs, "img/alph128.png", NULL);
-	if (!shdimg)
-		return false;
-
 	lvlsetpallet(0);
 
 	return true;
@@ -177,81 +230,154 @@ void lvlsetpallet(int p)
 	}
 }
 
-Lvl *lvlread(FILE *f)
+Lvl *lvlscan(char **bufp)
 {
+	char *p = *bufp;
+	while (isspace((unsigned char) *p))
+		p++;
+
+	int vers = 0;
+	if (*p == 'v') {
+		p++;
+		if (!scanint(&p, &vers) || vers < 0 || vers > Lvlvers) {
+			seterrstr("Unsupported lvl version");
+			return NULL;
+		}
+	}
+
 	int w, h, d, seenz;
-	if (fscanf(f, " %d %d %d %d",&d, &w, &h, &seenz) != 4) {
-		seterrstr("Invalid lvl header: w = %d, h = %d, d = %d, seenz = %d, feof = %d, ferror = %d", feof(f), ferror(f));
+	if (!scanint(&p, &d) || !scanint(&p, &w) || !scanint(&p, &h)
+			|| !scanint(&p, &seenz)) {
+		seterrstr("Invalid lvl header");
+		return NULL;
+	}
+	if (d <= 0 || d > Maxz || w <= 0 || h <= 0) {
+		seterrstr("Invalid lvl dimensions: d = %d, w = %d, h = %d", d, w, h);
 		return NULL;
 	}
 	Lvl *l = lvlnew(d, w, h, seenz);
 
 	int x, y, z;
 	x = y = z = 0;
-	if (fgetc(f) != '\n')
+	if (*p++ != '\n')
 		goto errnl;
 
 	for (z = 0; z < d; z++) {
 		for (y = 0; y < h; y++) {
-			for (x = 0; x < w; x++){
-				if (!tileread(f, l, x, y, z))
-					goto err;
-			}
-			if (fgetc(f) != '\n')
+			if (!tilescan(&p, l, y, z, vers))
+				goto err;
+			x = w;
+			if (*p++ != '\n')
 				goto errnl;
 		}
-		if (z < d - 1 && fgetc(f) != '\n')
+		if (z < d - 1 && *p++ != '\n')
 			goto errnl;
 	}
+	*bufp = p;
 	return l;
 errnl:
 	seterrstr("Expected newline in level file: z=%d, x=%d, y=%d", z, x, y);
 err:
-	xfree(l);
+	lvlfree(l);
 	return NULL;
 }
 
 void lvlwrite(FILE *f, Lvl *l)
 {
-	fprintf(f, "%d %d %d %d\n", l->d, l->w, l->h, l->seenz);
+	Buf b = {};
+	lvlprint(&b, l);
+	fwrite(b.b, 1, b.n, f);
+	xfree(b.b);
+}
+
+void lvlprint(Buf *b, Lvl *l)
+{
+	char row[l->w + 1];
+
+	bufprintf(b, "v%d %d %d %d %d\n", Lvlvers, l->d, l->w, l->h, l->seenz);
 	for (int z = 0; z < l->d; z++) {
 		for (int y = 0; y < l->h; y++) {
-			for (int x = 0; x < l->w; x++) {
-				fputc(blk(l, x, y, z)->tile, f);
-			}
-			fputc('\n', f);
+			int n = tilerle(row, l, y, z);
+			row[n++] = '\n';
+			bufput(b, row, n);
 		}
-		fputc('\n', f);
+		bufput(b, "\n", 1);
 	}
 }
 
-static bool tileread(FILE *f, Lvl *l, int x, int y, int z)
+/* Scan row y of layer z, advancing *rowp past it.  Version 1 rows
+ * may prefix a tile with a decimal count to repeat it. */
+static bool tilescan(char **rowp, Lvl *l, int y, int z, int vers)
 {
-	int c = fgetc(f);
-	if (c == EOF) {
-		seterrstr("Unexpected EOF");
-		return false;
-	}
+	char *p = *rowp;
+
+	for (int x = 0; x < l->w; ) {
+		int n = 1;
+		if (vers > 0 && isdigit((unsigned char) *p)) {
+			for (n = 0; isdigit((unsigned char) *p); p++) {
+				n = n * 10 + *p - '0';
+				if (n > l->w - x) {
+					seterrstr("Tile run too long at x=%d, y=%d, z=%d", x, y, z);
+					return false;
+				}
+			}
+			if (n == 0) {
+				seterrstr("Empty tile run at x=%d, y=%d, z=%d", x, y, z);
+				return false;
+			}
+		}
 
-	if (!istile(c)) {
-		seterrstr("Invalid tile: %c at x=%d, y=%d, z=%d\n", c, x, y, z);
-		return false;
-	}
+		int c = (unsigned char) *p++;
+		if (c == '\0') {
+			seterrstr("Unexpected EOF");
+			return false;
+		}
 
-	if (z == 0 && tiles[c].flags & Tfdoor) {
-		seterrstr("Front door on x=%d, y=%d, z=0", x, y);
-		return false;
-	}
-	if (z == l->d - 1 && tiles[c].flags & Tbdoor) {
-		seterrstr("Back door on x=%d, y=%d, z=max", x, y);
-		return false;
-	}
+		if (!istile(c)) {
+			seterrstr("Invalid tile: %c at x=%d, y=%d, z=%d\n", c, x, y, z);
+			return false;
+		}
+
+		if (z == 0 && tiles[c].flags & Tfdoor) {
+			seterrstr("Front door on x=%d, y=%d, z=0", x, y);
+			return false;
+		}
+		if (z == l->d - 1 && tiles[c].flags & Tbdoor) {
+			seterrstr("Back door on x=%d, y=%d, z=max", x, y);
+			return false;
+		}
 
-	blk(l, x, y, z)->tile = c;
+		for (int i = 0; i < n; i++, x++)
+			tileinit(l, x, y, z, c);
+	}
 
+	*rowp = p;
 	return true;
 }
 
+/* Run-length encode row y of layer z into buf, returning the number
+ * of bytes written.  Runs shorter than Minrun are written verbatim,
+ * so the encoding is never longer than the row itself. */
+static int tilerle(char *buf, Lvl *l, int y, int z)
+{
+	int n = 0;
+
+	for (int x = 0; x < l->w; ) {
+		int c = blk(l, x, y, z)->tile;
+		int r = 1;
+		while (x + r < l->w && blk(l, x + r, y, z)->tile == c)
+			r++;
+		if (r >= Minrun) {
+			n += sprintf(buf + n, "%d%c", r, c);
+		} else {
+			memset(buf + n, c, r);
+			n += r;
+		}
+		x += r;
+	}
+	return n;
+}
+
 static Rect tilebbox(int x, int y)
 {
 	Point a = (Point) {x * Twidth, y * Theight};
@@ -266,33 +392,81 @@ void lvldraw(Gfx *g, Lvl *l, bool bkgrnd)
 		int pxx = x * Twidth;
 		for (int y = 0; y < h; y++) {
 			Blk *b = blk(l, x, y, l->z);
-			int vis = b->flags & Blkvis;
-			if (!vis && bkgrnd && !debugging)
+			if (!(b->flags & Blkvis) && !debugging)
 				continue;
-			int t = b->tile;
-			Point pt = {0};
-
-			if (vis || debugging) {
-				int mn = bkgrnd ? 0 : (Tlayers-1) / 2 + 1;
-				int mx = bkgrnd ? (Tlayers-1) / 2 : Tlayers-1;
-				pt = (Point){ pxx, y * Theight };
-				tiledrawlyrs(g, t, pt, mn, mx);
-			}
-			if (!bkgrnd) {
-				if(debugging){
-					Rect r = tilebbox(x, y);
-					camdrawrect(g, r, (Color){0,0,0,255});
-					continue;
-				}
-				if (!vis) {
-					Rect r = tilebbox(x, y);
-					camfillrect(g, r, (Color){0,0,0,255});
-				} else if (vis && isshaded(l, t, x, y)) {
-					shade(g, pt);
-				}
+
+			int mn = bkgrnd ? 0 : (Tlayers-1) / 2 + 1;
+			int mx = bkgrnd ? (Tlayers-1) / 2 : Tlayers-1;
+			Point pt = { pxx, y * Theight };
+			tiledrawlyrs(g, b->tile, pt, mn, mx);
+			if (!bkgrnd && debugging) {
+				Rect r = tilebbox(x, y);
+				camdrawrect(g, r, (Color){0,0,0,255});
 			}
 		}
 	}
+	if (!bkgrnd && !debugging)
+		maskdraw(g, l);
+}
+
+/* Draws the level's visibility mask, stretched over its blocks. */
+static void maskdraw(Gfx *g, Lvl *l)
+{
+	if (!l->mask) {
+		l->mask = imgstream(g, l->w, l->h);
+		if (!l->mask)
+			return;
+		l->maskz = l->z;
+		maskmark(l, 0, l->h);
+	}
+	if (l->maskz != l->z) {
+		l->maskz = l->z;
+		maskmark(l, 0, l->h);
+	}
+	if (l->masky0 < l->masky1)
+		maskupdate(l);
+
+	Rect r = { {0, 0}, {l->w * Twidth, l->h * Theight} };
+	camdrawscaled(g, l->mask, r);
+}
+
+/* Marks rows y0 up to y1 of the mask out of date. */
+static void maskmark(Lvl *l, int y0, int y1)
+{
+	if (y0 < 0)
+		y0 = 0;
+	if (y1 > l->h)
+		y1 = l->h;
+	if (l->masky0 >= l->masky1) {
+		l->masky0 = y0;
+		l->masky1 = y1;
+		return;
+	}
+	if (y0 < l->masky0)
+		l->masky0 = y0;
+	if (y1 > l->masky1)
+		l->masky1 = y1;
+}
+
+/* Rebuilds and uploads only the rows of the mask that are out of
+ * date. */
+static void maskupdate(Lvl *l)
+{
+	int y0 = l->masky0, n = l->masky1 - l->masky0;
+	Color *px = xalloc(l->w * n, sizeof(*px));
+	for (int y = y0; y < y0 + n; y++) {
+		for (int x = 0; x < l->w; x++) {
+			Blk *b = blk(l, x, y, l->z);
+			Color *c = &px[(y - y0) * l->w + x];
+			if (!(b->flags & Blkvis))
+				c->a = Unseenalpha;
+			else if (isshaded(l, x, y))
+				c->a = Shadealpha;
+		}
+	}
+	imgsetrows(l->mask, y0, n, px);
+	xfree(px);
+	l->masky0 = l->masky1 = 0;
 }
 
 static void tiledraw(Gfx *g, int t, Point pt, int l)
@@ -311,10 +485,9 @@ static void tiledrawlyrs(Gfx *g, int t, Point pt, int mn, int mx)
 	}
 }
 
-static bool isshaded(Lvl *l, int t, int x, int y)
+static bool isshaded(Lvl *l, int x, int y)
 {
-	assert(tiles[t].ok);
-	if (tiles[t].flags & Tcollide)
+	if (lvlhas(l, x, y, l->z, Pcollide))
 		return false;
 
 	return !isvis(l, x-1, y) || !isvis(l, x+1, y)
@@ -329,11 +502,6 @@ static bool isvis(Lvl *l, int x, int y)
 	return blk(l, x, y, l->z)->flags & Blkvis;
 }
 
-static void shade(Gfx *g, Point pt)
-{
-	camdrawimg(g, shdimg, pt);
-}
-
 void lvlminidraw(Gfx *g, Lvl *l, Point offs, int scale)
 {
 	int w = l->w, h = l->h;
@@ -342,10 +510,8 @@ void lvlminidraw(Gfx *g, Lvl *l, Point offs, int scale)
 			Blk *b = blk(l, x, y, l->z);
 			if (!(b->flags & Blkvis) && !debugging)
 				continue;
-			int t = b->tile;
-
 			Color c = (Color){ 255, 255, 255, 255 };
-			unsigned int flags = tiles[t].flags;
+			unsigned int flags = tileinfo(l, x, y, l->z).flags;
 			if(flags & Tcollide)
 				c = (Color){ 0, 0, 0 };
 			else if(flags & Tbdoor)
@@ -368,19 +534,6 @@ void lvlminidraw(Gfx *g, Lvl *l, Point offs, int scale)
 	}
 }
 
-void lvlupdate(Lvl *l)
-{
-	for (int i = 0; i < sizeof(tiles) / sizeof(tiles[0]); i++) {
-		if (!tiles[i].ok)
-			continue;
-		for (int l = 0; l < Tlayers; l++) {
-			if (tiles[i].anims[l].len == 0)
-				continue;
-			animupdate(&tiles[i].anims[l]);
-		}
-	}
-}
-
 Isect lvlisect(Lvl *l, Rect r, Point v)
 {
 	Rect test = hitzone(r, v);
@@ -390,8 +543,7 @@ Isect lvlisect(Lvl *l, Rect r, Point v)
 	rectmv(&mv, 0, v.y);
 	for (int x = test.a.x; x <= test.b.x; x++) {
 		for (int y = test.a.y; y <= test.b.y; y++) {
-			Blk *b = blk(l, x, y, l->z);
-			Isect is = tileisect(b->tile, x, y, mv);
+			Isect is = tileisect(l, x, y, mv);
 			if (is.is && is.dy > isect.dy) {
 				isect.is = true;
 				isect.dy = is.dy;
@@ -407,8 +559,7 @@ Isect lvlisect(Lvl *l, Rect r, Point v)
 	rectmv(&mv, v.x, v.y + (v.y < 0 ? isect.dy : -isect.dy));
 	for (int x = test.a.x; x <= test.b.x; x++) {
 		for (int y = test.a.y; y <= test.b.y; y++) {
-			Blk *b = blk(l, x, y, l->z);
-			Isect is = tileisect(b->tile, x, y, mv);
+			Isect is = tileisect(l, x, y, mv);
 			if (is.is && is.dx > isect.dx) {
 				isect.is = true;
 				isect.dx = is.dx;
@@ -420,12 +571,85 @@ Isect lvlisect(Lvl *l, Rect r, Point v)
 	return isect;
 }
 
-static Isect tileisect(int t, int x, int y, Rect r)
+void lvlsweep(Lvl *l, Rect r, Point v, Sweep *s)
 {
-	if (!tiles[t].ok)
-		printf("t=[%c]", t);
-	assert(tiles[t].ok);
-	if (!(tiles[t].flags & Tcollide))
+	Rect mv = r;
+	rectmv(&mv, v.x, v.y);
+	r = rectnorm(r);
+	mv = rectnorm(mv);
+	s->lvl = l;
+	s->box = (Rect){
+		{ fmin(r.a.x, mv.a.x), fmin(r.a.y, mv.a.y) },
+		{ fmax(r.b.x, mv.b.x), fmax(r.b.y, mv.b.y) },
+	};
+	s->n = 0;
+
+	Rect z = hitzone(r, v);
+	for (int x = z.a.x; x <= z.b.x; x++) {
+		for (int y = z.a.y; y <= z.b.y; y++) {
+			if (!lvlhas(l, x, y, l->z, Pcollide))
+				continue;
+			Rect tb = tilebbox(x, y);
+			if (!isection(s->box, tb).is)
+				continue;
+			if (s->n == Maxsweep) {
+				// An empty box sends every step to lvlisect.
+				s->box = (Rect){ { 1, 1 }, { 0, 0 } };
+				return;
+			}
+			s->tiles[s->n++] = tb;
+		}
+	}
+}
+
+static bool inbox(Rect box, Rect r)
+{
+	return r.a.x >= box.a.x && r.b.x <= box.b.x
+		&& r.a.y >= box.a.y && r.b.y <= box.b.y;
+}
+
+/* Any tile that lvlisect would find intersecting a step within the box
+ * intersects the box, so it was gathered, and any gathered tile that
+ * intersects the step is in the step's hitzone.  Steps that leave the
+ * box, or start deep inside a tile, get lvlisect. */
+Isect sweepisect(Sweep *s, Rect r, Point v)
+{
+	Isect isect = (Isect) { .is = 0, .dx = 0.0, .dy = 0.0 };
+	Rect mv = r;
+	rectmv(&mv, 0, v.y);
+	if (!inbox(s->box, mv))
+		return lvlisect(s->lvl, r, v);
+	for (int i = 0; i < s->n; i++) {
+		Isect is = isection(mv, s->tiles[i]);
+		if (is.is && is.dy > isect.dy) {
+			isect.is = true;
+			isect.dy = is.dy;
+		}
+	}
+
+	if (v.x == 0.0)
+		return isect;
+	if (isect.dy > fabs(v.y))
+		return lvlisect(s->lvl, r, v);
+
+	mv = r;
+	rectmv(&mv, v.x, v.y + (v.y < 0 ? isect.dy : -isect.dy));
+	if (!inbox(s->box, mv))
+		return lvlisect(s->lvl, r, v);
+	for (int i = 0; i < s->n; i++) {
+		Isect is = isection(mv, s->tiles[i]);
+		if (is.is && is.dx > isect.dx) {
+			isect.is = true;
+			isect.dx = is.dx;
+		}
+	}
+
+	return isect;
+}
+
+static Isect tileisect(Lvl *l, int x, int y, Rect r)
+{
+	if (!lvlhas(l, x, y, l->z, Pcollide))
 		return (Isect){ .is = 0 };
 	return isection(r, tilebbox(x, y));
 }
@@ -462,87 +686,101 @@ Tileinfo lvlmajorblk(Lvl *l, Rect r)
 
 Tileinfo tileinfo(Lvl *l, int x, int y, int z)
 {
-	int t = blk(l, x, y, z)->tile;
-	assert(tiles[t].ok);
-	return (Tileinfo) { .x = x, .y = y, .z = z, .flags = tiles[t].flags };
+	unsigned int i = y * l->w + x;
+	unsigned long long *w = &l->planes[z * l->pwords + i / 64];
+	unsigned int flags = 0;
+	for (int p = 0; p < Nplanes; p++, w += l->d * l->pwords)
+		flags |= (*w >> (i % 64) & 1) << p;
+	return (Tileinfo) { .x = x, .y = y, .z = z, .flags = flags };
 }
 
-static void swap(int *a, int *b)
-{
-	int t = *a;
-	*a = *b;
-	*b = t;
-}
+/* Quadrants, each as the direction of increasing depth followed by
+ * the direction of increasing column. */
+static const int quads[4][4] = {
+	{ 0, -1, 1, 0 },
+	{ 0, 1, 1, 0 },
+	{ 1, 0, 0, 1 },
+	{ -1, 0, 0, 1 },
+};
 
 /* Update the visibility of the level given that the player is viewing
- * the level from location (x, y).  This works by rasterizing
- * 'visibility lines' from (x,y) to each block on the convex hull of
- * the map.
+ * the level from location (x, y), using symmetric shadowcasting: each
+ * quadrant is scanned row by row outward from (x, y), and an opaque
+ * block splits the row's range of slopes, recursing on the part
+ * before it.  A block is seen if its center is within the unblocked
+ * slopes, so if a block can see (x, y) then (x, y) can see it.  A
+ * quadrant stops at the first row that is entirely blocked, so
+ * quadrants facing a nearby wall cost next to nothing.
  *
- * This seems pretty fast, it hardly changes the frame rendering time
- * at all. */
-void lvlvis(Lvl *l, int x, int y)
+ * Slopes are kept as fractions n/d, d > 0, of column over depth so
+ * that the scan is exact. */
+void lvlvis(Lvl *l, int x, int y, int r)
 {
-	for (int i = 0; i < l->w; i++) {
-		visline(l, x, y, i, 0);
-		visline(l, x, y, i, l->h - 1);
-	}
-	for (int i = 0; i < l->h; i++) {
-		visline(l, x, y, 0, i);
-		visline(l, x, y, l->w - 1, i);
+	Fov f = { .l = l, .x = x, .y = y, .r = r };
+	reveal(&f, x, y, 0, 0);
+	for (int i = 0; i < 4; i++) {
+		f.q = quads[i];
+		fovscan(&f, 1, -1, 1, 1, 1);
 	}
 }
 
-/*
- * Based on Bresenham's line algorithm: Rasterize a line from the
- * location (x0, y0) to (x1, y1).  Set rasterized blocks to visible,
- * stop when the line is finished or when a collidable block was hit.
- */
-static void visline(Lvl *l, int x0, int y0, int x1, int y1)
+/* Scan the row at depth between slopes sn/sd and en/ed. */
+static void fovscan(Fov *f, int depth, int sn, int sd, int en, int ed)
 {
-	bool steep = abs(y1 - y0) > abs(x1 - x0);
-	if (steep) {
-		swap(&x0, &y0);
-		swap(&x1, &y1);
-	}
-	int dx = abs(x1 - x0);
-	int dy = abs(y1 - y0);
-	double err = 0.0;
-	double derr = (double)dy / (double)dx;
-	int ystep = y0 < y1 ? 1 : -1;
-	int y = y0;
-	int xstep = x0 < x1 ? 1 : -1;
-	for (int x = x0; ; x += xstep) {
-		int px = steep ? y : x;
-		int py = steep ? x : y;
-		blk(l, px, py, l->z)->flags |= Blkvis;
-		if (blkd(l, px, py) || x == x1)
-			break;
-		err += derr;
-		if (err >= 0.5) {
-			/* Test if diagonal movement is blocked on sides. */
-			int x1 = steep ? y + ystep : x + xstep;
-			int y1 = steep ? x + xstep : y + ystep;
-			if (blkd(l, px, y1) && blkd(l, x1, py)) {
-				if (edge(l, x1, y1))
-					blk(l, x1, y1, l->z)->flags |= Blkvis;
-				break;
-			}
-			y += ystep;
-			err -= 1.0;
+	if (f->r > 0 && depth > f->r)
+		return;
+
+	// Columns whose centers round into the slopes, rounding ties
+	// toward the middle of the range.
+	int lo = floordiv(2 * depth * sn + sd, 2 * sd);
+	int hi = -floordiv(ed - 2 * depth * en, 2 * ed);
+
+	int prev = -1;	/* whether the last block was opaque, or -1 */
+	for (int col = lo; col <= hi; col++) {
+		int x = f->x + depth * f->q[0] + col * f->q[2];
+		int y = f->y + depth * f->q[1] + col * f->q[3];
+		bool in = x >= 0 && x < f->l->w && y >= 0 && y < f->l->h;
+		bool opq = !in || blkd(f->l, x, y);
+
+		if (in && (opq || (col * sd >= depth * sn && col * ed <= depth * en)))
+			reveal(f, x, y, depth, col);
+		if (prev == 1 && !opq) {
+			sn = 2 * col - 1;
+			sd = 2 * depth;
 		}
+		if (prev == 0 && opq)
+			fovscan(f, depth + 1, sn, sd, 2 * col - 1, 2 * depth);
+		prev = opq;
+	}
+	if (prev == 0)
+		fovscan(f, depth + 1, sn, sd, en, ed);
+}
+
+static void reveal(Fov *f, int x, int y, int depth, int col)
+{
+	if (f->r > 0 && depth * depth + col * col > f->r * f->r)
+		return;
+	Blk *b = blk(f->l, x, y, f->l->z);
+	if (!(b->flags & Blkvis)) {
+		b->flags |= Blkvis;
+		// The shading of the blocks beside it may change too.
+		if (f->l->z == f->l->maskz)
+			maskmark(f->l, y - 1, y + 2);
 	}
 }
 
-static bool edge(Lvl *l, int x, int y)
+/* Division rounding toward negative infinity, for b > 0. */
+static int floordiv(int a, int b)
 {
-	return x <= 0 || y <= 0 || x >= l->w - 1 || y >= l->h - 1;
+	int q = a / b;
+	if (a % b != 0 && a < 0)
+		q--;
+	return q;
 }
 
 static bool blkd(Lvl *l, int x, int y)
 {
-	int t = blk(l, x, y, l->z)->tile;
-	return tiles[t].flags & Topaque;
+	return lvlhas(l, x, y, l->z, Popaque);
 }
 
 double blkgrav(int flags)
@@ -2,6 +2,8 @@
 
 #include "../../include/mid.h"
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 
 void *xalloc(unsigned long n, unsigned long s){
 	void *v = calloc(n, s);
@@ -12,6 +14,49 @@ void *xalloc(unsigned long n, unsigned long s){
 	return v;
 }
 
+void *xrealloc(void *v, unsigned long s){
+	v = realloc(v, s);
+	if(!v){
+		fputs("out of memory\n", stderr);
+		exit(1);
+	}
+	return v;
+}
+
 void xfree(void *v){
 	free(v);
 }
+
+static void bufgrow(Buf *b, int n){
+	if(b->n + n <= b->sz)
+		return;
+	int sz = b->sz ? b->sz : 64;
+	while(sz < b->n + n)
+		sz *= 2;
+	b->b = xrealloc(b->b, sz);
+	b->sz = sz;
+}
+
+void bufput(Buf *b, const char *s, int n){
+	bufgrow(b, n);
+	memcpy(b->b + b->n, s, n);
+	b->n += n;
+}
+
+void bufprintf(Buf *b, const char *fmt, ...){
+	va_list ap;
+
+	va_start(ap, fmt);
+	int n = vsnprintf(b->b + b->n, b->sz - b->n, fmt, ap);
+	va_end(ap);
+	if(n < b->sz - b->n){
+		b->n += n;
+		return;
+	}
+
+	bufgrow(b, n + 1);
+	va_start(ap, fmt);
+	vsnprintf(b->b + b->n, b->sz - b->n, fmt, ap);
+	va_end(ap);
+	b->n += n;
+}
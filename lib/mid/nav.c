@@ -0,0 +1,363 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+#include "../../include/mid.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct Navent Navent;
+struct Navent {
+	int f, n;
+};
+
+enum {
+	// As in lvlgen's reach.c, a body can jump up Uplim blocks.
+	Uplim = 2,
+	// Each height of a jump, including none, can go left or right.
+	Maxedges = 2 * (Uplim + 1),
+	// The most nodes that a search closes before giving up.
+	Maxsearch = 1024,
+	// Once the searches of a tick have closed this many nodes, no
+	// more are started until the next tick.
+	Searchbudget = 2 * Maxsearch,
+	// The most moves from a node to the flow field's source.
+	Maxflow = 64,
+	// In place of a node for a colliding block.
+	Solid = -2,
+};
+
+/* The graph has a node for each block that a body can stand in: an
+ * open block over a colliding one.  Nodes are numbered in row-major
+ * order, and the edges out of node n are edges[edge0[n]] up to
+ * edges[edge0[n+1]]. */
+struct Nav {
+	int w, h;
+	int *node;	// node of each block of the layer, -1, or Solid
+	int n;
+	int *blk;	// block of each node
+	int *edge0, *edges;
+	int *redge0, *redges;	// the same for edges into each node
+
+	// The flow field toward node src, found by navflow.  A node's
+	// step and dist are only valid if its fmark is fstamp.
+	int src;
+	int *step;	// the next node toward src, or -1 at src
+	int *dist;	// moves to src
+	unsigned int *fmark, fstamp;
+	int *queue;
+
+	// Search scratch.  A node's g and prev are only valid if its
+	// mark is the current stamp.
+	int *g, *prev;
+	unsigned int *mark, stamp;
+	Navent *heap;
+	int nheap;
+	int budget;	// nodes left to close this tick
+};
+
+static int edges(Nav *, Lvl *, int z, int n, int *out);
+static bool open(Lvl *, int z, int x, int y);
+static bool search(Nav *, int from, int goal);
+static int cost(Nav *, int a, int b);
+static void heappush(Nav *, int n, int f);
+static int heappop(Nav *);
+
+Nav *navnew(Lvl *l, int z)
+{
+	Nav *nv = xalloc(1, sizeof(*nv));
+	nv->w = l->w;
+	nv->h = l->h;
+	nv->node = xalloc(l->w * l->h, sizeof(*nv->node));
+	for (int y = 0; y < l->h; y++) {
+		for (int x = 0; x < l->w; x++) {
+			int i = y * l->w + x;
+			nv->node[i] = -1;
+			if (!open(l, z, x, y))
+				nv->node[i] = Solid;
+			else if (y + 1 < l->h && !open(l, z, x, y + 1))
+				nv->node[i] = nv->n++;
+		}
+	}
+
+	int n = nv->n + 1;
+	nv->blk = xalloc(n, sizeof(*nv->blk));
+	for (int i = 0; i < l->w * l->h; i++) {
+		if (nv->node[i] >= 0)
+			nv->blk[nv->node[i]] = i;
+	}
+
+	nv->edge0 = xalloc(n, sizeof(*nv->edge0));
+	nv->edges = xalloc(n * Maxedges, sizeof(*nv->edges));
+	int m = 0;
+	for (int i = 0; i < nv->n; i++) {
+		nv->edge0[i] = m;
+		m += edges(nv, l, z, i, nv->edges + m);
+	}
+	nv->edge0[nv->n] = m;
+
+	nv->redge0 = xalloc(n, sizeof(*nv->redge0));
+	nv->redges = xalloc(m + 1, sizeof(*nv->redges));
+	for (int e = 0; e < m; e++)
+		nv->redge0[nv->edges[e]]++;
+	for (int i = 0, sum = 0; i <= nv->n; i++) {
+		int d = nv->redge0[i];
+		nv->redge0[i] = sum;
+		sum += d;
+	}
+	for (int i = 0; i < nv->n; i++) {
+		for (int e = nv->edge0[i]; e < nv->edge0[i + 1]; e++)
+			nv->redges[nv->redge0[nv->edges[e]]++] = i;
+	}
+	// Each count was advanced to the start of the next node's.
+	for (int i = nv->n; i > 0; i--)
+		nv->redge0[i] = nv->redge0[i - 1];
+	nv->redge0[0] = 0;
+
+	nv->src = -1;
+	nv->step = xalloc(n, sizeof(*nv->step));
+	nv->dist = xalloc(n, sizeof(*nv->dist));
+	nv->fmark = xalloc(n, sizeof(*nv->fmark));
+	nv->fstamp = 1;
+	nv->queue = xalloc(n, sizeof(*nv->queue));
+
+	nv->g = xalloc(n, sizeof(*nv->g));
+	nv->prev = xalloc(n, sizeof(*nv->prev));
+	nv->mark = xalloc(n, sizeof(*nv->mark));
+	nv->heap = xalloc(n * Maxedges, sizeof(*nv->heap));
+	nv->budget = Searchbudget;
+	return nv;
+}
+
+void navfree(Nav *nv)
+{
+	if (!nv)
+		return;
+	xfree(nv->node);
+	xfree(nv->blk);
+	xfree(nv->edge0);
+	xfree(nv->edges);
+	xfree(nv->redge0);
+	xfree(nv->redges);
+	xfree(nv->step);
+	xfree(nv->dist);
+	xfree(nv->fmark);
+	xfree(nv->queue);
+	xfree(nv->g);
+	xfree(nv->prev);
+	xfree(nv->mark);
+	xfree(nv->heap);
+	xfree(nv);
+}
+
+/* Store in out the nodes reached from node n by moving a block left
+ * or right, after jumping up to Uplim blocks, and falling to the
+ * ground.  Falling out of the level reaches no node.  Returns the number of nodes stored. */
+static int edges(Nav *nv, Lvl *l, int z, int n, int *out)
+{
+	int x = nv->blk[n] % l->w, y = nv->blk[n] / l->w;
+	int m = 0;
+	for (int up = 0; up <= Uplim && open(l, z, x, y - up); up++) {
+		for (int dx = -1; dx <= 1; dx += 2) {
+			int to = navnode(nv, x + dx, y - up);
+			int i = 0;
+			while (i < m && out[i] != to)
+				i++;
+			if (to >= 0 && i == m)
+				out[m++] = to;
+		}
+	}
+	return m;
+}
+
+static bool open(Lvl *l, int z, int x, int y)
+{
+	return x >= 0 && x < l->w && y >= 0 && y < l->h
+		&& !lvlhas(l, x, y, z, Pcollide);
+}
+
+int navnode(Nav *nv, int x, int y)
+{
+	if (x < 0 || x >= nv->w || y < 0)
+		return -1;
+	for (; y < nv->h; y++) {
+		int n = nv->node[y * nv->w + x];
+		if (n != -1)
+			return n == Solid ? -1 : n;
+	}
+	return -1;
+}
+
+void navflow(Nav *nv, int x, int y)
+{
+	int src = navnode(nv, x, y);
+	if (src == nv->src)
+		return;
+	nv->src = src;
+	if (++nv->fstamp == 0) {
+		for (int i = 0; i < nv->n; i++)
+			nv->fmark[i] = 0;
+		nv->fstamp = 1;
+	}
+	if (src < 0)
+		return;
+
+	// Breadth-first back along the edges from src.
+	nv->fmark[src] = nv->fstamp;
+	nv->step[src] = -1;
+	nv->dist[src] = 0;
+	nv->queue[0] = src;
+	for (int h = 0, t = 1; h < t; h++) {
+		int n = nv->queue[h];
+		if (nv->dist[n] == Maxflow)
+			continue;
+		for (int e = nv->redge0[n]; e < nv->redge0[n + 1]; e++) {
+			int m = nv->redges[e];
+			if (nv->fmark[m] == nv->fstamp)
+				continue;
+			nv->fmark[m] = nv->fstamp;
+			nv->step[m] = n;
+			nv->dist[m] = nv->dist[n] + 1;
+			nv->queue[t++] = m;
+		}
+	}
+}
+
+_Bool navstep(Nav *nv, int x, int y, int *nx, int *ny)
+{
+	int n = navnode(nv, x, y);
+	if (n < 0 || nv->fmark[n] != nv->fstamp || nv->step[n] < 0)
+		return false;
+	int b = nv->blk[nv->step[n]];
+	*nx = b % nv->w;
+	*ny = b / nv->w;
+	return true;
+}
+
+_Bool navnext(Nav *nv, Navpath *p, int x, int y, int gx, int gy, int *nx, int *ny)
+{
+	int from = navnode(nv, x, y);
+	int goal = navnode(nv, gx, gy);
+	if (from < 0 || goal < 0 || from == goal)
+		return false;
+
+	if (p->goal == goal && p->n > 0 && p->nodes[p->n - 1] == from) {
+		p->at = from;
+		p->n--;
+	}
+	bool stale = p->goal != goal || p->at != from || p->n == 0;
+	if (stale && p->goal == goal && p->at == from && p->n < 0)
+		return false;
+	if (stale && nv->budget <= 0) {
+		// Keep to the old path while the body is still on it,
+		// and search on a later tick.
+		if (p->at != from || p->n <= 0)
+			return false;
+		stale = false;
+	}
+	if (stale) {
+		p->goal = goal;
+		p->at = from;
+		p->n = -1;
+		if (!search(nv, from, goal))
+			return false;
+
+		// Keep the first Maxpath steps, nearest last.  A longer
+		// path is searched again when they are used up.
+		int len = 0;
+		for (int n = goal; n != from; n = nv->prev[n])
+			len++;
+		p->n = 0;
+		for (int n = goal; n != from; n = nv->prev[n]) {
+			if (len-- <= Maxpath)
+				p->nodes[p->n++] = n;
+		}
+	}
+
+	int b = nv->blk[p->nodes[p->n - 1]];
+	*nx = b % nv->w;
+	*ny = b / nv->w;
+	return true;
+}
+
+void navtick(Nav *nv)
+{
+	nv->budget = Searchbudget;
+}
+
+/* Finds the cheapest path from from to goal with A*, leaving it in
+ * prev, walking back from goal.  The nodes it closes are taken from
+ * the tick's budget. */
+static bool search(Nav *nv, int from, int goal)
+{
+	if (++nv->stamp == 0) {
+		for (int i = 0; i < nv->n; i++)
+			nv->mark[i] = 0;
+		nv->stamp = 1;
+	}
+	nv->nheap = 0;
+
+	nv->mark[from] = nv->stamp;
+	nv->g[from] = 0;
+	heappush(nv, from, cost(nv, from, goal));
+
+	for (int closed = 0; nv->nheap > 0 && closed < Maxsearch; closed++) {
+		int n = heappop(nv);
+		nv->budget--;
+		if (n == goal)
+			return true;
+		for (int e = nv->edge0[n]; e < nv->edge0[n + 1]; e++) {
+			int m = nv->edges[e];
+			int g = nv->g[n] + cost(nv, n, m);
+			if (nv->mark[m] == nv->stamp && g >= nv->g[m])
+				continue;
+			// Rather than moving m up the heap, it is pushed
+			// again.  The old entry is popped later and
+			// expanded without finding anything cheaper.
+			nv->mark[m] = nv->stamp;
+			nv->g[m] = g;
+			nv->prev[m] = n;
+			heappush(nv, m, g + cost(nv, m, goal));
+		}
+	}
+	return false;
+}
+
+/* The Manhattan distance in blocks, which is both the cost of a move
+ * and a lower bound on the cost of a path. */
+static int cost(Nav *nv, int a, int b)
+{
+	int ax = nv->blk[a] % nv->w, ay = nv->blk[a] / nv->w;
+	int bx = nv->blk[b] % nv->w, by = nv->blk[b] / nv->w;
+	return abs(ax - bx) + abs(ay - by);
+}
+
+static void heappush(Nav *nv, int n, int f)
+{
+	if (nv->nheap == (nv->n + 1) * Maxedges)
+		return;
+	int i = nv->nheap++;
+	while (i > 0 && nv->heap[(i - 1) / 2].f > f) {
+		nv->heap[i] = nv->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	nv->heap[i] = (Navent){ f, n };
+}
+
+static int heappop(Nav *nv)
+{
+	int top = nv->heap[0].n;
+	Navent last = nv->heap[--nv->nheap];
+	int i = 0;
+	for (;;) {
+		int c = 2 * i + 1;
+		if (c >= nv->nheap)
+			break;
+		if (c + 1 < nv->nheap && nv->heap[c + 1].f < nv->heap[c].f)
+			c++;
+		if (nv->heap[c].f >= last.f)
+			break;
+		nv->heap[i] = nv->heap[c];
+		i = c;
+	}
+	nv->heap[i] = last;
+	return top;
+}
@@ -16,7 +16,7 @@ Info nousinfo = {
 		.item = { ItemCopper, ItemSilver },
 		.prob = { 85, 15 }
 	},
-	.death = EnemySplat
+	.death = PartSplat
 };
 
 _Bool nousinit(Enemy *e, int x, int y){
@@ -36,6 +36,10 @@ void nousupdate(Enemy *e, Player *p, Zone *z){
 	enemygenupdate(e, p, z, &nousinfo);
 }
 
+void noustouch(Enemy *e, Player *p, Zone *z, int hits){
+	enemygentouch(e, p, z, &nousinfo, hits);
+}
+
 void nousdraw(Enemy *e, Gfx *g){
 	Rect clip;
 	if(e->body.vel.x < 0)
@@ -49,7 +53,7 @@ void nousdraw(Enemy *e, Gfx *g){
 			{ 64, 32 }
 		};
 
-	Point p = e->body.bbox.a;
+	Point p = bodydrawpt(&e->body);
 	p.x -= 3;
 	camdrawreg(g, nousimg, clip, p);
 }
@@ -0,0 +1,122 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+#include "../../include/mid.h"
+#include <assert.h>
+
+typedef struct PartOps PartOps;
+struct PartOps{
+	char *animname; // or NULL to draw a sz square of color
+	int life; // ticks
+	double grav;
+	Point vel; // of the middle of a burst
+	double spread; // of a burst's velocities
+	Color color;
+	double sz;
+	Anim anim;
+};
+
+static PartOps ops[] = {
+	[PartSplat] = {
+		"img/splat.png",
+		600/Ticktm,
+		0,
+		{ 0, 0 },
+		0,
+		{ 0 },
+		32,
+		{ .row = 0, .len = 3, .delay = 200/Ticktm, .w = 32, .h = 32 }
+	},
+	[PartSpark] = {
+		NULL,
+		160/Ticktm,
+		0.5,
+		{ 0, -3 },
+		3,
+		{ 255, 240, 160, 255 },
+		3,
+	},
+	[PartSplash] = {
+		NULL,
+		300/Ticktm,
+		0.5,
+		{ 0, -4 },
+		2,
+		{ 80, 140, 255, 255 },
+		4,
+	},
+};
+
+_Bool partldresrc(void){
+	for (int id = 1; id < PartMax; id++) {
+		char *n = ops[id].animname;
+		if(!n)
+			continue;
+
+		Img *a = resrcacq(imgs, n, NULL);
+		if(!a)
+			return 0;
+
+		ops[id].anim.sheet = a;
+	}
+	return 1;
+}
+
+void partadd(Parts *ps, PartID id, Point loc, int n){
+	assert(id > PartNone && id < PartMax);
+	PartOps *o = &ops[id];
+
+	for(int k = 0; k < n; k++){
+		int i = ps->next;
+		ps->next = (ps->next + 1) % Maxparts;
+
+		// Spread the burst evenly across [-spread, spread].
+		double s = n > 1 ? (2.0 * k / (n - 1) - 1) * o->spread : 0;
+		ps->id[i] = id;
+		ps->age[i] = 0;
+		ps->x[i] = ps->px[i] = loc.x;
+		ps->y[i] = ps->py[i] = loc.y;
+		ps->dx[i] = o->vel.x + s;
+		ps->dy[i] = o->vel.y + (k % 2) * o->spread / 2;
+	}
+}
+
+void partupdate(Parts *ps){
+	for(int i = 0; i < Maxparts; i++){
+		if(!ps->id[i])
+			continue;
+		PartOps *o = &ops[ps->id[i]];
+		if(++ps->age[i] >= o->life){
+			ps->id[i] = PartNone;
+			continue;
+		}
+		ps->px[i] = ps->x[i];
+		ps->py[i] = ps->y[i];
+		ps->x[i] += ps->dx[i];
+		ps->y[i] += ps->dy[i];
+		ps->dy[i] += o->grav;
+	}
+}
+
+/* Particles are drawn a kind at a time, so that each kind's image or
+ * color is used for one run of draws.  The squares of a color are
+ * filled with a single draw. */
+void partdraw(Parts *ps, Gfx *g){
+	Rect sqs[Maxparts];
+	for(int id = 1; id < PartMax; id++){
+		PartOps *o = &ops[id];
+		int nsqs = 0;
+		for(int i = 0; i < Maxparts; i++){
+			if(ps->id[i] != id)
+				continue;
+			Point loc = ticklerp((Point){ ps->px[i], ps->py[i] }, (Point){ ps->x[i], ps->y[i] });
+			if(!o->animname){
+				sqs[nsqs++] = (Rect){ loc, { loc.x + o->sz, loc.y + o->sz } };
+				continue;
+			}
+			Anim a = o->anim;
+			a.start = curtick - ps->age[i];
+			camdrawanim(g, &a, loc);
+		}
+		camfillrects(g, sqs, nsqs, o->color);
+	}
+}
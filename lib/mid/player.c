@@ -21,6 +21,7 @@ static void mvsw(Player *);
 static Rect attackclip(Player *p, int up);
 static ArmorSetID armset(Player*);
 static EqpLoc armtoeqp(ArmorLoc);
+static int armorsheets(Gfx *, Player *, Img *[ArmorMax]);
 
 void playerinit(Player *p, int x, int y)
 {
@@ -68,6 +69,13 @@ void playerinit(Player *p, int x, int y)
 	mvsw(p);
 }
 
+void playerfree(Player *p)
+{
+	if(p->armcomp)
+		imgfree(p->armcomp);
+	p->armcomp = NULL;
+}
+
 static void trydoorstairs(Player *p, Zone *zn, Tileinfo bi)
 {
 	Lvl *l = zn->lvl;
@@ -106,6 +114,8 @@ void playersetloc(Player *p, int x, int y)
 
 void playerupdate(Player *p, Zone *zn, Point *tr)
 {
+	bodystart(&p->body);
+	p->previmgloc = p->imgloc;
 	chkdirkeys(p);
 
 	Lvl *l = zn->lvl;
@@ -114,8 +124,16 @@ void playerupdate(Player *p, Zone *zn, Point *tr)
 	Tileinfo bi = lvlmajorblk(l, p->body.bbox);
 
 	if (bi.x != p->bi.x || bi.y != p->bi.y || bi.z != p->bi.z)
-		lvlvis(l, bi.x, bi.y);
+		lvlvis(l, bi.x, bi.y, 0);
+	if((bi.flags & Twater) && !(p->bi.flags & Twater) && bi.z == p->bi.z){
+		Rect bb = p->body.bbox;
+		Point loc = { (bb.a.x + bb.b.x) / 2, bb.b.y - Theight / 2 };
+		partadd(&zn->parts[bi.z], PartSplash, loc, 6);
+	}
 	p->bi = bi;
+	Nav *nv = zonenav(zn, bi.z);
+	if (nv)
+		navflow(nv, bi.x, bi.y);
 
 	double olddx = p->body.vel.x;
 	if(olddx && p->hitback == 0)
@@ -140,8 +158,6 @@ void playerupdate(Player *p, Zone *zn, Point *tr)
 	chngact(p);
 	if(p->dir != prevdir)
 		for(int i = 0; i < ArmorMax; i++) animreset(&p->as[p->dir][p->act][i]);
-	else
-		for(int i = 0; i < ArmorMax; i++) animupdate(&p->as[p->dir][p->act][i]);
 
 	Point del = { playerpos(p).x - ppos.x, playerpos(p).y - ppos.y };
 	*tr = scroll(p, del);
@@ -169,30 +185,73 @@ void playerdraw(Gfx *g, Player *p)
 	if(debugging)
 		camfillrect(g, p->body.bbox, (Color){255,0,0,255});
 
+	Point loc = ticklerp(p->previmgloc, p->imgloc);
 	if(p->iframes % 4 == 0){
-		if(p->sframes > 8)
-			for(int i = 0; i < ArmorMax; i++){
-				int loc = armtoeqp(i);
-				ArmorSetID as = itemarmorset(p->wear[loc].id);
-				imgdrawreg(g, armorsetsheet(as, i), attackclip(p, 0), p->imgloc);
-			}
-		else if(p->sframes > 0)
-			for(int i = 0; i < ArmorMax; i++){
-				int loc = armtoeqp(i);
-				ArmorSetID as = itemarmorset(p->wear[loc].id);
-				imgdrawreg(g, armorsetsheet(as, i), attackclip(p, 1), p->imgloc);
-			}
-		else
-			for(int i = 0; i < ArmorMax; i++){
-				int loc = armtoeqp(i);
-				ArmorSetID as = itemarmorset(p->wear[loc].id);
-				p->as[p->dir][p->act][i].sheet = armorsetsheet(as, i);
-				animdraw(g, &p->as[p->dir][p->act][i], p->imgloc);
+		Img *sheets[ArmorMax];
+		int n = armorsheets(g, p, sheets);
+		for(int i = 0; i < n; i++){
+			if(p->sframes > 8)
+				imgdrawreg(g, sheets[i], attackclip(p, 0), loc);
+			else if(p->sframes > 0)
+				imgdrawreg(g, sheets[i], attackclip(p, 1), loc);
+			else{
+				// The layers' animations all run in step.
+				Anim a = p->as[p->dir][p->act][0];
+				a.sheet = sheets[i];
+				animdraw(g, &a, loc);
 			}
+		}
 	}
 
-	if(p->sw.cur >= 0)
+	if(p->sw.cur >= 0){
+		// The sword moves with the player's drawn location.
+		Point d = bodydrawpt(&p->body);
+		d.x -= p->body.bbox.a.x;
+		d.y -= p->body.bbox.a.y;
+		cammove(g, d.x, d.y);
 		sworddraw(g, &p->sw);
+		cammove(g, -d.x, -d.y);
+	}
+}
+
+/* Get the sheets to draw, bottom layer first, for the player's armor,
+ * returning how many there are.  Normally this is a single sheet with
+ * all of the layers composited, which is only redrawn when the armor
+ * or its images change or the renderer loses it.  If the renderer
+ * can't draw to images then it is one sheet per layer. */
+static int armorsheets(Gfx *g, Player *p, Img *sheets[ArmorMax])
+{
+	unsigned long resets = gfxresets(g), reloads = armorreloads();
+	if(p->armcomp && !p->armdirty && p->armresets == resets
+	&& p->armreloads == reloads){
+		sheets[0] = p->armcomp;
+		return 1;
+	}
+
+	for(int i = 0; i < ArmorMax; i++)
+		sheets[i] = armorsetsheet(itemarmorset(p->wear[armtoeqp(i)].id), i);
+	if(!p->armcomp && !p->armfailed){
+		Point wh = imgdims(sheets[0]);
+		p->armcomp = imgtarget(g, wh.x, wh.y);
+		p->armfailed = !p->armcomp;
+	}
+	if(!p->armcomp)
+		return ArmorMax;
+
+	// The bottom layer replaces the old composite.  Blending it
+	// onto a transparent target would multiply its colors by its
+	// alpha, and they would be again when the composite is drawn.
+	gfxtarget(g, p->armcomp);
+	imgcopy(g, sheets[0], (Point){0,0});
+	for(int i = 1; i < ArmorMax; i++)
+		imgdraw(g, sheets[i], (Point){0,0});
+	gfxtarget(g, NULL);
+
+	p->armdirty = false;
+	p->armresets = resets;
+	p->armreloads = reloads;
+	sheets[0] = p->armcomp;
+	return 1;
 }
 
 static void chkdirkeys(Player *p)
@@ -282,8 +341,7 @@ static void loadanim(Anim *a, int row, int len, int delay, int shid)
 		.len = len,
 		.delay = delay/Ticktm,
 		.w = Twidth,
-		.h = Theight,
-		.d = delay/Ticktm
+		.h = Theight
 	};
 }
 
@@ -371,6 +429,7 @@ static Rect attackclip(Player *p, int col){
 
 void resetstats(Player *p){
 	memset(p->eqp, 0, sizeof(p->eqp));
+	p->armdirty = true;
 
 	for(int i = EqpHead; i < EqpMax; i++)
 		if(p->wear[i].id > 0) for(int j = 0; j < StatMax; j++)
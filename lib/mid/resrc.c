@@ -1,17 +1,28 @@
 /* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
 
 /* A resource table finds and tracks resource usage (reference
- * counts).  A finite number of unreferenced resources are kept in a
- * simple cache with a FIFO-ish replacement policy. */
+ * counts).  Unreferenced resources are kept in a cache until the
+ * table's resources use more than its memory budget, or the cache
+ * holds Cachesize resources, and then the least recently used are
+ * unloaded.  Images packed into the atlas share its texture, so they
+ * are pinned: they are never unloaded and aren't counted against the
+ * budget.
+ *
+ * File names and paths are interned, so each distinct string is
+ * stored once and a resource's key is a small integer.  The table
+ * itself is open-addressed with linear probing, and its slots index
+ * an array of entries. */
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
+#include <SDL_thread.h>
+#include <SDL_mutex.h>
 #include "fs.h"
 #include "../../include/mid.h"
 
-enum { Initsize = 257 };
-enum { Fillfact = 3 };
+enum { Initslots = 256 };
 enum { Cachesize = 100 };
+enum { Defbudget = 64 << 20 };
 
 static const char *roots[] = { "resrc", "../Resources" };
 enum { NROOTS = sizeof(roots) / sizeof(roots[0]) };
@@ -19,20 +30,31 @@ enum { NROOTS = sizeof(roots) / sizeof(roots[0]) };
 typedef struct Resrc Resrc;
 struct Resrc {
 	void *resrc, *aux;
-	char file[PATH_MAX + 1], path[PATH_MAX + 1];
-	int refs, cind;
-	Resrc *nxt;
-	Resrc *unxt;
+	unsigned int hash;
+	unsigned long bytes;
+	int file, path;	/* interned; file is -1 if the entry is free */
+	int refs;
+	bool pinned;	/* in the atlas */
+	/* Links in the cache's LRU list if refs is 0, or in the free
+	 * list if the entry is free. */
+	int prev, next;
 };
 
 struct Rtab {
-	Resrc **tbl;
-	int sz, fill;
-	Resrc *cache[Cachesize]; /* cache of unused nodes. */
+	Resrc *ents;
+	int nents, szents;
+	int free;		/* head of the free entry list */
+	int *slots;		/* entry index + 1, or 0 if empty */
+	int nslots, fill;
+	int lru, mru;		/* ends of the cache list, or -1 */
 	int cfill;
 	Resrcops *ops;
+	Rtabstats st;
+	void (*reloaded)(void *resrc);
 };
 
+static Resrc *preloaded(Rtab *, const char *, void *);
+
 /* From K&R 2nd edition. */
 unsigned int strhash(const char *s)
 {
@@ -42,108 +64,239 @@ unsigned int strhash(const char *s)
 	return h;
 }
 
-unsigned int hash(Resrcops *ops, const char *file, void *aux)
+static char **strs;
+static int nstrs, szstrs;
+static int *strslots;	/* string ID + 1, or 0 if empty */
+static int nstrslots;
+
+static void strslotins(int id)
 {
-	if (ops->hash)
-		return ops->hash(file, aux);
-	return strhash(file);
+	unsigned int i = strhash(strs[id]) & (nstrslots - 1);
+	while (strslots[i])
+		i = (i + 1) & (nstrslots - 1);
+	strslots[i] = id + 1;
 }
 
-bool eq(Resrcops *ops, Resrc *r, const char *file, void *aux)
+/* Returns the ID of s, adding it if add is true, or -1 if it isn't
+ * interned. */
+static int intern(const char *s, bool add)
 {
-	if (ops->eq)
-		return ops->eq(r->aux, aux) && strcmp(r->file, file) == 0;
-	return strcmp(r->file, file) == 0;
+	if (nstrslots > 0) {
+		unsigned int i = strhash(s) & (nstrslots - 1);
+		for (; strslots[i]; i = (i + 1) & (nstrslots - 1)) {
+			if (strcmp(strs[strslots[i] - 1], s) == 0)
+				return strslots[i] - 1;
+		}
+	}
+	if (!add)
+		return -1;
+
+	if ((nstrs + 1) * 2 > nstrslots) {
+		xfree(strslots);
+		nstrslots = nstrslots ? nstrslots * 2 : Initslots;
+		strslots = xalloc(nstrslots, sizeof(*strslots));
+		for (int id = 0; id < nstrs; id++)
+			strslotins(id);
+	}
+	if (nstrs == szstrs) {
+		szstrs = szstrs ? szstrs * 2 : Initslots;
+		strs = xrealloc(strs, szstrs * sizeof(*strs));
+	}
+	int n = strlen(s) + 1;
+	strs[nstrs] = xalloc(n, 1);
+	memcpy(strs[nstrs], s, n);
+	strslotins(nstrs);
+	return nstrs++;
 }
 
-static Resrc *tblfind(Resrcops *ops, Resrc *tbl[], int sz,
-		      const char *file, void *aux)
+static unsigned int keyhash(Resrcops *ops, int file, void *aux)
 {
-	if (sz == 0)
-		return NULL;
+	unsigned int h = (unsigned int) file * 2654435761u;
+	if (ops->hash)
+		h ^= ops->hash(aux);
+	return h;
+}
 
-	unsigned int i = hash(ops, file, aux) % sz;
-	Resrc *p = NULL;
-	for (p = tbl[i]; p; p = p->nxt)
-		if (eq(ops, p, file, aux))
-			break;
-	return p;
+static bool keyeq(Resrcops *ops, Resrc *r, int file, void *aux)
+{
+	if (r->file != file)
+		return false;
+	return !ops->eq || ops->eq(r->aux, aux);
 }
 
-static void tblrem(Resrcops *ops, Resrc *tbl[], int sz, Resrc *rm)
+/* Returns the index of the entry for the key, or -1. */
+static int tblfind(Rtab *t, int file, void *aux)
 {
-	unsigned int i = hash(ops, rm->file, rm->aux) % sz;
-	if (tbl[i] == rm) {
-		tbl[i] = rm->nxt;
-		return;
+	if (t->nslots == 0 || file < 0)
+		return -1;
+
+	unsigned int mask = t->nslots - 1;
+	unsigned int i = keyhash(t->ops, file, aux) & mask;
+	for (; t->slots[i]; i = (i + 1) & mask) {
+		int e = t->slots[i] - 1;
+		if (keyeq(t->ops, &t->ents[e], file, aux))
+			return e;
 	}
-	Resrc *p;
-	for (p = tbl[i]; p->nxt && p->nxt != rm; p = p->nxt)
-		;
-	assert(p->nxt);
+	return -1;
+}
 
-	if (p->nxt == rm)
-		p->nxt = rm->nxt;
+static void slotins(Rtab *t, int e)
+{
+	unsigned int mask = t->nslots - 1;
+	unsigned int i = t->ents[e].hash & mask;
+	while (t->slots[i])
+		i = (i + 1) & mask;
+	t->slots[i] = e + 1;
 }
 
-static void tblins(Resrcops *ops, Resrc *tbl[], int sz, Resrc *r)
+/* Removes entry e from the slots, shifting back any later entries of
+ * its probe sequence so that lookups don't need tombstones. */
+static void tblrem(Rtab *t, int e)
 {
-	unsigned int i = hash(ops, r->file, r->aux) % sz;
-	assert (!r->nxt);
-	r->nxt = tbl[i];
-	tbl[i] = r;
+	unsigned int mask = t->nslots - 1;
+	unsigned int i = t->ents[e].hash & mask;
+	while (t->slots[i] != e + 1) {
+		assert(t->slots[i]);
+		i = (i + 1) & mask;
+	}
+
+	unsigned int j = i;
+	for (;;) {
+		t->slots[i] = 0;
+		for (;;) {
+			j = (j + 1) & mask;
+			if (!t->slots[j]) {
+				t->fill--;
+				return;
+			}
+			unsigned int k = t->ents[t->slots[j] - 1].hash & mask;
+			// Move slot j to i unless its home, k, is
+			// cyclically in (i, j].
+			if (i <= j ? (i >= k || k > j) : (i >= k && k > j))
+				break;
+		}
+		t->slots[i] = t->slots[j];
+		i = j;
+	}
 }
 
-static void rtabgrow(Rtab *t)
+static void tblins(Rtab *t, int e)
 {
-	int nxtsz = t->sz * 2;
-	if (nxtsz == 0)
-		nxtsz = Initsize;
-	Resrc **nxttbl = xalloc(nxtsz, sizeof(*nxttbl));
-	for (int i = 0; i < t->sz; i++) {
-		for (Resrc *p = t->tbl[i]; p; p = p->nxt)
-			tblins(t->ops, nxttbl, nxtsz, p);
+	if ((t->fill + 1) * 2 > t->nslots) {
+		xfree(t->slots);
+		t->nslots = t->nslots ? t->nslots * 2 : Initslots;
+		t->slots = xalloc(t->nslots, sizeof(*t->slots));
+		for (int i = 0; i < t->nents; i++) {
+			if (t->ents[i].file >= 0)
+				slotins(t, i);
+		}
 	}
-	if (t->tbl)
-		xfree(t->tbl);
-	t->tbl = nxttbl;
-	t->sz = nxtsz;
+	slotins(t, e);
+	t->fill++;
 }
 
-static void cacherm(Rtab *t, int i)
+static void cacherm(Rtab *t, int e)
 {
-	t->cache[i]->cind = -1;
+	Resrc *r = &t->ents[e];
+	t->st.cached -= r->bytes;
+	if (r->prev >= 0)
+		t->ents[r->prev].next = r->next;
+	else
+		t->lru = r->next;
+	if (r->next >= 0)
+		t->ents[r->next].prev = r->prev;
+	else
+		t->mru = r->prev;
+	r->prev = r->next = -1;
 	t->cfill--;
-	t->cache[i] = t->cache[t->cfill];
-	if (t->cfill > 0)
-		t->cache[i]->cind = i;
 }
 
-static void cacheresrc(Rtab *t, Resrc *r)
+
+static void entfree(Rtab *t, int e)
 {
-	if (t->cfill == Cachesize) {
-		Resrc *bump = t->cache[0];
-		cacherm(t, 0);
-		tblrem(t->ops, t->tbl, t->sz, bump);
-		if (t->ops->unload)
-			t->ops->unload(bump->path, bump->resrc, bump->aux);
-		xfree(bump);
+	Resrc *r = &t->ents[e];
+	if (t->ops->unload)
+		t->ops->unload(strs[r->path], r->resrc, r->aux);
+	t->st.resident -= r->bytes;
+	t->st.nresident--;
+	r->file = -1;
+	r->next = t->free;
+	t->free = e;
+}
+
+/* Unloads the least recently used resources until the table is
+ * within its limits. */
+static void evict(Rtab *t)
+{
+	while (t->cfill > Cachesize
+			|| (t->cfill > 0 && t->st.resident - t->st.pinned > t->st.budget)) {
+		int bump = t->lru;
+		cacherm(t, bump);
+		tblrem(t, bump);
+		entfree(t, bump);
+		t->st.evictions++;
 	}
-	assert (t->cfill < Cachesize);
-	t->cache[t->cfill] = r;
-	r->cind = t->cfill;
+}
+
+static void cacheresrc(Rtab *t, int e)
+{
+	Resrc *r = &t->ents[e];
+	r->prev = t->mru;
+	r->next = -1;
+	if (t->mru >= 0)
+		t->ents[t->mru].next = e;
+	else
+		t->lru = e;
+	t->mru = e;
 	t->cfill++;
+	t->st.cached += r->bytes;
+	evict(t);
 }
 
-static Resrc *resrcnew(const char *path, const char *file, void *aux)
+static int entnew(Rtab *t)
 {
-	Resrc *r = xalloc(1, sizeof(*r));
-	if (!r)
-		return NULL;
-	strncpy(r->file, file, PATH_MAX + 1);
-	strncpy(r->path, path, PATH_MAX + 1);
+	if (t->free >= 0) {
+		int e = t->free;
+		t->free = t->ents[e].next;
+		return e;
+	}
+	if (t->nents == t->szents) {
+		t->szents = t->szents ? t->szents * 2 : Initslots / 2;
+		t->ents = xrealloc(t->ents, t->szents * sizeof(*t->ents));
+	}
+	return t->nents++;
+}
+
+static bool resrcpath(const char *file, char path[PATH_MAX + 1])
+{
+	for (int i = 0; i < NROOTS; i += 1) {
+		fscat(roots[i], file, path);
+		if (fsexists(path))
+			return true;
+	}
+	seterrstr("Not found");
+	return false;
+}
+
+static Resrc *resrcins(Rtab *t, const char *path, const char *file, void *aux, void *resrc)
+{
+	int e = entnew(t);
+	Resrc *r = &t->ents[e];
+	r->resrc = resrc;
 	r->aux = aux;
-	r->cind = -1;
+	r->file = intern(file, true);
+	r->path = intern(path, true);
+	r->hash = keyhash(t->ops, r->file, aux);
+	r->refs = 0;
+	r->pinned = false;
+	r->prev = r->next = -1;
+	r->bytes = 0;
+	if (resrc && t->ops->bytes)
+		r->bytes = t->ops->bytes(resrc, aux);
+	tblins(t, e);
+	t->st.loads++;
+	t->st.resident += r->bytes;
+	t->st.nresident++;
 
 	return r;
 }
@@ -151,49 +304,38 @@ static Resrc *resrcnew(const char *path, const char *file, void *aux)
 static Resrc *resrcload(Rtab *t, const char *file, void *aux)
 {
 	char path[PATH_MAX + 1];
-	bool found = false;
-	for (int i = 0; !found && i < NROOTS; i += 1) {
-		fscat(roots[i], file, path);
-		found = fsexists(path);
-	}
-	if (!found) {
-		seterrstr("Not found");
-		return NULL;
-	}
-
-	Resrc *r = resrcnew(path, file, aux);
-	if (!r)
+	if (!resrcpath(file, path))
 		return NULL;
-	r->resrc = t->ops->load(path, aux);
-	t->fill++;
-	if (t->fill * Fillfact >= t->sz)
-		rtabgrow(t);
-	tblins(t->ops, t->tbl, t->sz, r);
-
-	return r;
+	return resrcins(t, path, file, aux, t->ops->load(path, aux));
 }
 
 void *resrcacq(Rtab *t, const char *file, void *aux)
 {
-	Resrc *r = tblfind(t->ops, t->tbl, t->sz, file, aux);
-	if (!r)
-		r = resrcload(t, file, aux);
-	else if (r->refs == 0)
-		cacherm(t, r->cind);
-	if (!r)
-		return NULL;
-	r->refs++;
-	return r->resrc;
+	int e = tblfind(t, intern(file, false), aux);
+	if (e >= 0) {
+		t->st.hits++;
+		if (t->ents[e].refs == 0)
+			cacherm(t, e);
+	} else {
+		t->st.misses++;
+		Resrc *r = preloaded(t, file, aux);
+		if (!r)
+			r = resrcload(t, file, aux);
+		if (!r)
+			return NULL;
+		e = r - t->ents;
+	}
+	t->ents[e].refs++;
+	return t->ents[e].resrc;
 }
 
 void resrcrel(Rtab *t, const char *file, void *aux)
 {
-	Resrc *r = tblfind(t->ops, t->tbl, t->sz, file, aux);
-	assert(r);
-
-	r->refs--;
-	if (r->refs == 0)
-		cacheresrc(t, r);
+	int e = tblfind(t, intern(file, false), aux);
+	assert(e >= 0 && t->ents[e].refs > 0);
+	t->ents[e].refs--;
+	if (t->ents[e].refs == 0)
+		cacheresrc(t, e);
 }
 
 Rtab *rtabnew(Resrcops *ops)
@@ -203,24 +345,72 @@ Rtab *rtabnew(Resrcops *ops)
 		return NULL;
 
 	t->ops = ops;
+	t->free = -1;
+	t->lru = t->mru = -1;
+	t->st.budget = Defbudget;
 
 	return t;
 }
 
 void rtabfree(Rtab *t)
 {
-	for (int i = 0; i < t->sz; i += 1) {
-		Resrc *p, *q;
-		for (p = q = t->tbl[i]; p; p = q) {
-			if (t->ops->unload)
-				t->ops->unload(p->path, p->resrc, p->aux);
-			q = p->nxt;
-			xfree(p);
-		}
+	for (int i = 0; i < t->nents; i += 1) {
+		if (t->ents[i].file >= 0 && t->ops->unload)
+			t->ops->unload(strs[t->ents[i].path], t->ents[i].resrc, t->ents[i].aux);
 	}
+	if (t->ents)
+		xfree(t->ents);
+	if (t->slots)
+		xfree(t->slots);
 	xfree(t);
 }
 
+void rtabbudget(Rtab *t, unsigned long bytes)
+{
+	t->st.budget = bytes;
+	evict(t);
+}
+
+void rtabonreload(Rtab *t, void (*fn)(void *resrc))
+{
+	t->reloaded = fn;
+}
+
+Rtabstats rtabstats(Rtab *t)
+{
+	Rtabstats st = t->st;
+	st.ncached = t->cfill;
+	return st;
+}
+
+/* Reloads the resources loaded from path. */
+static void rtabreload(Rtab *t, int path)
+{
+	if (!t->ops->reload)
+		return;
+	for (int i = 0; i < t->nents; i++) {
+		Resrc *r = &t->ents[i];
+		if (r->file < 0 || r->path != path || !r->resrc)
+			continue;
+		if (!t->ops->reload(strs[path], r->resrc, r->aux))
+			continue;
+		t->st.reloads++;
+		if (t->reloaded)
+			t->reloaded(r->resrc);
+
+		unsigned long bytes = 0;
+		if (t->ops->bytes)
+			bytes = t->ops->bytes(r->resrc, r->aux);
+		t->st.resident += bytes - r->bytes;
+		if (r->pinned)
+			t->st.pinned += bytes - r->bytes;
+		if (r->refs == 0)
+			t->st.cached += bytes - r->bytes;
+		r->bytes = bytes;
+	}
+	evict(t);
+}
+
 Rtab *imgs;
 
 void *imgload(const char *path, void *_ignrd)
@@ -233,9 +423,21 @@ void imgunload(const char *path, void *img, void *_info)
 	imgfree(img);
 }
 
+unsigned long imgsize(void *img, void *_info)
+{
+	return imgbytes(img);
+}
+
+_Bool imgreloadresrc(const char *path, void *img, void *_info)
+{
+	return imgreload(img, path);
+}
+
 static Resrcops imgtype = {
 	.load = imgload,
 	.unload = imgunload,
+	.bytes = imgsize,
+	.reload = imgreloadresrc,
 };
 
 Rtab *txt;
@@ -251,10 +453,10 @@ void txtunload(const char *path, void *txt, void *_info)
 	txtfree(txt);
 }
 
-unsigned int txthash(const char *path, void *_info)
+unsigned int txthash(void *_info)
 {
 	Txtinfo *info = _info;
-	return strhash(path) ^ info->size
+	return info->size
 		^ (info->color.r << 24)
 		^ (info->color.g << 16)
 		^ (info->color.b << 8)
@@ -271,11 +473,24 @@ bool txteq(void *_a, void *_b)
 		&& a->color.a == b->color.a;
 }
 
+unsigned long txtsize(void *txt, void *_info)
+{
+	return txtbytes(txt);
+}
+
+_Bool txtreloadresrc(const char *path, void *txt, void *_info)
+{
+	Txtinfo *info = _info;
+	return txtreload(txt, path, info->size);
+}
+
 static Resrcops txttype = {
 	.load = txtload,
 	.unload = txtunload,
 	.hash = txthash,
 	.eq = txteq,
+	.bytes = txtsize,
+	.reload = txtreloadresrc,
 };
 
 Rtab *music;
@@ -290,6 +505,7 @@ void musicunload(const char *path, void *music, void *_info)
 	musicfree(music);
 }
 
+/* Music is streamed from its file, so it isn't counted. */
 static Resrcops musictype = {
 	.load = musicload,
 	.unload = musicunload,
@@ -304,14 +520,227 @@ void *sfxload(const char *path, void *_ignrd)
 
 void sfxunload(const char *path, void *s, void *_info)
 {
-	sfxnew(s);
+	sfxfree(s);
+}
+
+unsigned long sfxsize(void *s, void *_info)
+{
+	return sfxbytes(s);
+}
+
+_Bool sfxreloadresrc(const char *path, void *s, void *_info)
+{
+	return sfxreload(s, path);
 }
 
 static Resrcops sfxtype = {
 	.load = sfxload,
 	.unload = sfxunload,
+	.bytes = sfxsize,
+	.reload = sfxreloadresrc,
+};
+
+/* Resources in the manifest are decoded by loader threads, started
+ * by initresrc, while the game gets on with other things.  When one
+ * is first acquired, resrcacq waits for it only if it isn't decoded
+ * yet, and images are made into textures on the acquiring thread.
+ * Fonts aren't preloaded, since SDL_ttf isn't thread-safe. */
+enum Prekind { Preatlas, Preimg, Presfx };
+
+typedef struct Preload Preload;
+struct Preload {
+	const char *file;
+	enum Prekind kind;
+	char path[PATH_MAX + 1];	/* empty if the file wasn't found */
+	void *data;			/* Imgdata or Sfx */
+	bool done, taken;
+};
+
+/* Preatlas images are sprite sheets that are packed into a single
+ * texture when the first of them is acquired.  They stay loaded until
+ * freeresrc. */
+static Preload manifest[] = {
+	{ "img/tiles.png", Preatlas }, { "img/tiles0.png", Preatlas },
+	{ "img/items.png", Preatlas }, { "img/swords.png", Preatlas },
+	{ "img/woosh.png", Preatlas }, { "img/ui.png", Preatlas },
+	{ "img/shrine.png", Preatlas }, { "img/swstones.png", Preatlas },
+	{ "img/orb.png", Preatlas },
+	{ "img/unti.png", Preatlas }, { "img/nous.png", Preatlas },
+	{ "img/da.png", Preatlas }, { "img/thu.png", Preatlas },
+	{ "img/grendu.png", Preatlas }, { "img/splat.png", Preatlas },
+	{ "img/naked.png", Preatlas }, { "img/naked-arm-back.png", Preatlas },
+	{ "img/naked-body.png", Preatlas }, { "img/naked-helm.png", Preatlas },
+	{ "img/naked-arm-front.png", Preatlas }, { "img/naked-legs.png", Preatlas },
+	{ "img/iron.png", Preatlas }, { "img/iron-arm-back.png", Preatlas },
+	{ "img/iron-body.png", Preatlas }, { "img/iron-helm.png", Preatlas },
+	{ "img/iron-arm-front.png", Preatlas }, { "img/iron-legs.png", Preatlas },
+	{ "img/title.png", Preimg },
+	{ "sfx/ow.wav", Presfx }, { "sfx/hit.wav", Presfx },
+	{ "sfx/gold.wav", Presfx }, { "sfx/yum.wav", Presfx },
 };
 
+enum { Nmanifest = sizeof(manifest) / sizeof(manifest[0]) };
+enum { Maxloaders = 8 };
+
+static SDL_mutex *premtx;
+static SDL_cond *predone;
+static int prenext;
+static SDL_Thread *loaders[Maxloaders];
+static int nloaders;
+
+static int preloader(void *unused)
+{
+	for (;;) {
+		SDL_LockMutex(premtx);
+		int i = prenext++;
+		SDL_UnlockMutex(premtx);
+		if (i >= Nmanifest)
+			return 0;
+
+		Preload *p = &manifest[i];
+		void *data = NULL;
+		if (p->path[0] && p->kind == Presfx)
+			data = sfxnew(p->path);
+		else if (p->path[0])
+			data = imgdecode(p->path);
+
+		SDL_LockMutex(premtx);
+		p->data = data;
+		p->done = true;
+		SDL_CondBroadcast(predone);
+		SDL_UnlockMutex(premtx);
+	}
+}
+
+static void prestart(void)
+{
+	for (int i = 0; i < Nmanifest; i++) {
+		if (!resrcpath(manifest[i].file, manifest[i].path))
+			manifest[i].path[0] = '\0';
+	}
+
+	premtx = SDL_CreateMutex();
+	predone = SDL_CreateCond();
+	if (!premtx || !predone) {
+		// Without the locks everything is loaded on demand.
+		for (int i = 0; i < Nmanifest; i++)
+			manifest[i].taken = true;
+		return;
+	}
+
+	int n = SDL_GetCPUCount();
+	if (n > Maxloaders)
+		n = Maxloaders;
+	for (nloaders = 0; nloaders < n; nloaders++) {
+		loaders[nloaders] = SDL_CreateThread(preloader, "preload", NULL);
+		if (!loaders[nloaders])
+			break;
+	}
+	if (nloaders == 0)
+		preloader(NULL);
+}
+
+static void prewait(Preload *p)
+{
+	SDL_LockMutex(premtx);
+	while (!p->done)
+		SDL_CondWait(predone, premtx);
+	SDL_UnlockMutex(premtx);
+}
+
+/* Packs all of the Preatlas images into the atlas, returning the
+ * Resrc for file, or NULL if it failed to decode. */
+static Resrc *preatlas(const char *file)
+{
+	Preload *ps[Nmanifest];
+	Imgdata *ds[Nmanifest];
+	Img *is[Nmanifest];
+	int n = 0;
+
+	for (int i = 0; i < Nmanifest; i++) {
+		Preload *p = &manifest[i];
+		if (p->kind != Preatlas || p->taken)
+			continue;
+		prewait(p);
+		p->taken = true;
+		// Images that fail to decode here are loaded again, and
+		// the failure reported, when they are acquired.
+		if (!p->data)
+			continue;
+		ps[n] = p;
+		ds[n] = p->data;
+		p->data = NULL;
+		n++;
+	}
+	imgatlas(is, ds, n);
+
+	int found = -1;
+	for (int i = 0; i < n; i++) {
+		if (!is[i])
+			continue;
+		Resrc *r = resrcins(imgs, ps[i]->path, ps[i]->file, NULL, is[i]);
+		r->refs++;
+		r->pinned = true;
+		imgs->st.pinned += r->bytes;
+		if (strcmp(ps[i]->file, file) == 0)
+			found = r - imgs->ents;
+	}
+	return found < 0 ? NULL : &imgs->ents[found];
+}
+
+/* Returns the Resrc for the manifest entry for file, or NULL if there
+ * isn't one or it failed to load. */
+static Resrc *preloaded(Rtab *t, const char *file, void *aux)
+{
+	if (t != imgs && t != sfx)
+		return NULL;
+
+	Preload *p = NULL;
+	for (int i = 0; i < Nmanifest; i++) {
+		if (!manifest[i].taken && strcmp(manifest[i].file, file) == 0
+				&& (manifest[i].kind == Presfx) == (t == sfx)) {
+			p = &manifest[i];
+			break;
+		}
+	}
+	if (!p)
+		return NULL;
+	if (p->kind == Preatlas)
+		return preatlas(file);
+
+	prewait(p);
+	p->taken = true;
+	void *resrc = p->kind == Presfx ? p->data : imgupload(p->data);
+	p->data = NULL;
+	if (!resrc)
+		return NULL;
+	return resrcins(t, p->path, file, aux, resrc);
+}
+
+/* Waits for the loaders and frees anything they loaded that was never
+ * acquired. */
+static void prestop(void)
+{
+	for (int i = 0; i < nloaders; i++)
+		SDL_WaitThread(loaders[i], NULL);
+	nloaders = 0;
+
+	for (int i = 0; i < Nmanifest; i++) {
+		Preload *p = &manifest[i];
+		if (p->taken || !p->data)
+			continue;
+		if (p->kind == Presfx)
+			sfxfree(p->data);
+		else
+			imgdatafree(p->data);
+		p->data = NULL;
+	}
+	if (predone)
+		SDL_DestroyCond(predone);
+	if (premtx)
+		SDL_DestroyMutex(premtx);
+}
+
 void initresrc(void)
 {
 	imgs = rtabnew(&imgtype);
@@ -322,10 +751,59 @@ void initresrc(void)
 	assert(music != NULL);
 	sfx = rtabnew(&sfxtype);
 	assert(sfx != NULL);
+	prestart();
+}
+
+/* Resource directories that resrcwatch watches under each root. */
+static const char *watchdirs[] = { "img", "sfx", "txt" };
+enum { Nwatchdirs = sizeof(watchdirs) / sizeof(watchdirs[0]) };
+
+static Watch *watch;
+
+_Bool resrcwatch(void)
+{
+	if (!watch)
+		watch = watchnew();
+	if (!watch)
+		return false;
+
+	int n = 0;
+	for (int i = 0; i < NROOTS; i++) {
+		for (int j = 0; j < Nwatchdirs; j++) {
+			char dir[PATH_MAX + 1];
+			fscat(roots[i], watchdirs[j], dir);
+			if (fsexists(dir) && watchdir(watch, dir))
+				n++;
+		}
+	}
+	return n > 0;
+}
+
+void resrcpoll(void)
+{
+	if (!watch)
+		return;
+
+	char path[PATH_MAX + 1];
+	while (watchnext(watch, path)) {
+		// A file that was never loaded isn't interned.
+		int id = intern(path, false);
+		if (id < 0)
+			continue;
+		rtabreload(imgs, id);
+		rtabreload(txt, id);
+		rtabreload(music, id);
+		rtabreload(sfx, id);
+	}
 }
 
 void freeresrc(void)
 {
+	if (watch) {
+		watchfree(watch);
+		watch = NULL;
+	}
+	prestop();
 	rtabfree(sfx);
 	rtabfree(music);
 	rtabfree(txt);
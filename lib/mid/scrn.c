@@ -3,17 +3,25 @@
 #include "../../include/mid.h"
 #include <assert.h>
 
-void framestart(void);
-void framefinish(void);
+double framems(void);
+_Bool framefinish(double);
+void framedelay(int);
 
 enum { Stkmax = 8 };
 
+/* After a hitch, at most Maxcatchup ticks are run to catch up, and
+ * the rest of the time is dropped.  Without vsync, frames are drawn at
+ * most every Minframetm ms. */
+enum { Maxcatchup = 5, Minframetm = 4 };
+
 struct Scrnstk{
 	Scrn *scrns[Stkmax];
 	Scrn **nxt;
 	Gfx *g;
 };
 
+static int scrnloop(void *);
+
 Scrnstk *scrnstknew(Gfx *g){
 	Scrnstk *s = xalloc(1, sizeof(*s));
 	s->nxt = s->scrns;
@@ -56,23 +64,63 @@ void scrnstkpop(Scrnstk *stk){
 	cammove(stk->g, p.x, p.y);
 }
 
+/* The screens are updated every Ticktm ms of real time, and drawn as
+ * often as the display allows, with tickalpha set to how far the
+ * frame is between the last two ticks.  The updates and draws run on
+ * their own thread, so a frame is drawn while the last one is
+ * presented. */
 void scrnrun(Scrnstk *stk){
+	gfxrun(stk->g, scrnloop, stk);
+}
+
+static int scrnloop(void *p){
+	Scrnstk *stk = p;
+	double prev = framems();
+	double acc = 0;
+
 	for(;;){
 		Scrn *s = scrnstktop(stk);
 		if(!s)
-			return;
+			return 0;
 
-		framestart();
-		s->mt->update(s, stk);
-		s->mt->draw(s, stk->g);
+		double start = framems();
+		double dt = start - prev;
+		prev = start;
+		// Ignored frames (loading a zone, say) aren't caught up.
+		if(!framefinish(dt))
+			dt = 0;
+		if(dt > Maxcatchup * Ticktm)
+			dt = Maxcatchup * Ticktm;
+		acc += dt;
+
+		resrcpoll();
 
 		Event e;
 		while(pollevent(&e)){
 			if(e.type == Quit)
-				return;
+				return 0;
 			s->mt->handle(s, stk, &e);
+			if(scrnstktop(stk) != s)
+				break;
+		}
+
+		while(acc >= Ticktm){
+			s = scrnstktop(stk);
+			if(!s)
+				return 0;
+			s->mt->update(s, stk);
+			curtick++;
+			acc -= Ticktm;
 		}
 
-		framefinish();
+		s = scrnstktop(stk);
+		if(!s)
+			return 0;
+		tickalpha = acc / Ticktm;
+		s->mt->draw(s, stk->g);
+
+		double ftime = framems() - start;
+		if(ftime < Minframetm)
+			framedelay(Minframetm - ftime);
 	}
 }
@@ -8,158 +8,299 @@
 #include <string.h>
 #include <stdint.h>
 #include <limits.h>
+#include <math.h>
+#include <stdbool.h>
 
 // Ensure that unsigned long long is at least 64 bits.
 enum { assert_keychar_eq = 1/!!(sizeof(unsigned long long) >= sizeof(uint64_t)) };
 
-static void scanint(char **toks, int *d);
-static void scanuint64_t(char **toks, uint64_t *d);
-static void scandbl(char **toks, double *f);
-static void scanbool(char **toks, _Bool *b);
-static void scanpt(char **toks, Point *pt);
-static void scanrect(char **toks, Rect *r);
-static void scanbody(char **toks, Body *b);
-static void scaninvit(char **toks, Invit *i);
-static void scansword(char **toks, Sword *s);
-static void scanplayer(char **toks, Player *p);
+static _Bool scanuint64_t(char **toks, uint64_t *d);
+static _Bool scandbl(char **toks, double *f);
+static _Bool scanbool(char **toks, _Bool *b);
+static _Bool scanpt(char **toks, Point *pt);
+static _Bool scanrect(char **toks, Rect *r);
+static _Bool scanbody(char **toks, Body *b);
+static _Bool scaninvit(char **toks, Invit *i);
+static _Bool scansword(char **toks, Sword *s);
+static _Bool scanplayer(char **toks, Player *p);
+static _Bool scandigits(char **toks, uint64_t *u, _Bool *neg);
 static char *nxt(char **toks);
+static void skiptok(char **toks);
+static _Bool isdelim(int c);
+static _Bool isdig(int c);
 static void printpt(char **bufp, int *szp, Point p);
 static void printrect(char **bufp, int *szp, Rect r);
 static void printbody(char **bufp, int *szp, Body b);
 static void printinvit(char **bufp, int *szp, Invit);
 static void printsword(char **bufp, int *szp, Sword s);
 static void printplayer(char **bufp, int *szp, Player p);
+static void printdbl(char **bufp, int *szp, double d);
 static void prfield(char **bufp, int *szp, char *fmt, ...);
 
+typedef struct Bin Bin;
+
+/* Bin is a cursor over a packed buffer.  The same walkers both pack
+ * and unpack, so the binary layout is only written down once. */
+struct Bin {
+	unsigned char *p, *end;
+	_Bool pack;
+	_Bool ok;
+};
+
+static void binbytes(Bin *b, uint64_t *v, int n);
+static void binint(Bin *b, int *d);
+static void bindbl(Bin *b, double *f);
+static void binbool(Bin *b, _Bool *t);
+static void binpt(Bin *b, Point *pt);
+static void binrect(Bin *b, Rect *r);
+static void binbody(Bin *b, Body *y);
+static void bininvit(Bin *b, Invit *it);
+static void binsword(Bin *b, Sword *s);
+static void binplayer(Bin *b, Player *p);
+
 _Bool scangeom(char *buf, char *fmt, ...)
 {
 	va_list ap;
 	char *f = fmt;
-	char * toks = buf;
+	char *toks = buf;
+	_Bool ok = true;
 
 	va_start(ap, fmt);
-	while (*f) {
+	while (ok && *f) {
 		switch (*f) {
-		case 'd': scanint(&toks, va_arg(ap, int*)); break;
-		case 'f': scandbl(&toks, va_arg(ap, double*)); break;
-		case 'b': scanbool(&toks, va_arg(ap, _Bool*)); break;
-		case 'p': scanpt(&toks, va_arg(ap, Point*)); break;
-		case 'r': scanrect(&toks, va_arg(ap, Rect*)); break;
-		case 'y': scanbody(&toks, va_arg(ap, Body*)); break;
-		case 'l': scanplayer(&toks, va_arg(ap, Player*)); break;
-		case 'u': scanuint64_t(&toks, va_arg(ap, uint64_t*)); break;
+		case 'd': ok = scanint(&toks, va_arg(ap, int*)); break;
+		case 'f': ok = scandbl(&toks, va_arg(ap, double*)); break;
+		case 'b': ok = scanbool(&toks, va_arg(ap, _Bool*)); break;
+		case 'p': ok = scanpt(&toks, va_arg(ap, Point*)); break;
+		case 'r': ok = scanrect(&toks, va_arg(ap, Rect*)); break;
+		case 'y': ok = scanbody(&toks, va_arg(ap, Body*)); break;
+		case 'l': ok = scanplayer(&toks, va_arg(ap, Player*)); break;
+		case 'u': ok = scanuint64_t(&toks, va_arg(ap, uint64_t*)); break;
 		}
 		f++;
 	}
 	va_end(ap);
 
-	return *f == '\0';
+	return ok && *f == '\0';
 }
 
-static void scanint(char **toks, int *d)
+_Bool scanint(char **toks, int *d)
 {
-	char *t = nxt(toks);
-	long l = strtol(t, NULL, 10);
-	if (l == LONG_MAX || l == LONG_MIN)
-		fatal("Over/under-flow reading integer");
-	*d = l;
+	uint64_t u;
+	_Bool neg;
+	if (!scandigits(toks, &u, &neg))
+		return false;
+	if (u > (neg ? -(uint64_t)INT_MIN : INT_MAX)) {
+		seterrstr("Over/under-flow reading integer");
+		return false;
+	}
+	*d = neg ? -(int64_t)u : (int64_t)u;
+	return true;
 }
 
-static void scanuint64_t(char **toks, uint64_t *d)
+static _Bool scanuint64_t(char **toks, uint64_t *d)
 {
-	char *t = nxt(toks);
-	unsigned long long l = strtoull(t, NULL, 10);
-
-	if (l == ULLONG_MAX)
-		fatal("Over/under-flow reading 64-bit unsigned integer");
-	*d = l;
+	_Bool neg;
+	if (!scandigits(toks, d, &neg))
+		return false;
+	if (neg) {
+		seterrstr("Negative 64-bit unsigned integer");
+		return false;
+	}
+	return true;
 }
 
-static void scandbl(char **toks, double *f)
+/* Powers of ten that are exactly representable as a double. */
+static const double pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22,
+};
+
+enum { Maxpow10 = sizeof(pow10) / sizeof(pow10[0]) - 1 };
+
+/* Doubles written by printgeom are short decimals.  An integer
+ * mantissa of at most 53 bits divided by an exact power of ten is
+ * correctly rounded by a single IEEE division, so it gives the same
+ * result as strtod.  Anything else (exponents, long mantissas, inf,
+ * nan) falls back to strtod. */
+static _Bool scandbl(char **toks, double *f)
 {
 	char *t = nxt(toks);
-	double l = strtod(t, NULL);
-	*f = l;
+	if (!t)
+		return false;
+
+	char *s = t;
+	_Bool neg = *s == '-';
+	if (*s == '-' || *s == '+')
+		s++;
+
+	uint64_t m = 0;
+	int nd = 0, e = 0;
+	for (; isdig(*s); s++, nd++)
+		m = m * 10 + (*s - '0');
+	if (*s == '.') {
+		for (s++; isdig(*s); s++, nd++, e--)
+			m = m * 10 + (*s - '0');
+	}
+
+	if (nd > 0 && nd <= 19 && isdelim(*s) && m <= UINT64_C(1) << 53
+			&& e >= -Maxpow10) {
+		double d = (double) m / pow10[-e];
+		*f = neg ? -d : d;
+		*toks = s;
+		return true;
+	}
+
+	char *end;
+	*f = strtod(t, &end);
+	skiptok(toks);
+	return end != t;
 }
 
-static void scanbool(char **toks, _Bool *b)
+static _Bool scanbool(char **toks, _Bool *b)
 {
 	int i;
-	scanint(toks, &i);
+	if (!scanint(toks, &i))
+		return false;
 	*b = i;
+	return true;
 }
 
-static void scanpt(char **toks, Point *pt)
+static _Bool scanpt(char **toks, Point *pt)
 {
-	scandbl(toks, &pt->x);
-	scandbl(toks, &pt->y);
+	return scandbl(toks, &pt->x)
+		&& scandbl(toks, &pt->y);
 }
 
-static void scanrect(char **toks, Rect *r)
+static _Bool scanrect(char **toks, Rect *r)
 {
-	scanpt(toks, &r->a);
-	scanpt(toks, &r->b);
+	return scanpt(toks, &r->a)
+		&& scanpt(toks, &r->b);
 }
 
-static void scanbody(char **toks, Body *b)
+static _Bool scanbody(char **toks, Body *b)
 {
-	scanrect(toks, &b->bbox);
-	scanpt(toks, &b->vel);
-	scanpt(toks, &b->acc);
-	scanbool(toks, &b->fall);
+	if (!scanrect(toks, &b->bbox))
+		return false;
+	// A body that was just read hasn't moved, so there's nothing
+	// to interpolate from.
+	b->prev = b->bbox.a;
+	return scanpt(toks, &b->vel)
+		&& scanpt(toks, &b->acc)
+		&& scanbool(toks, &b->fall);
 }
 
-static void scaninvit(char **toks, Invit *it)
+static _Bool scaninvit(char **toks, Invit *it)
 {
-	scanint(toks, (int*)&it->id);
-	for (int i = 0; i < StatMax; i++)
-		scanint(toks, &it->stats[i]);
+	if (!scanint(toks, (int*)&it->id))
+		return false;
+	for (int i = 0; i < StatMax; i++) {
+		if (!scanint(toks, &it->stats[i]))
+			return false;
+	}
+	return true;
 }
 
-static void scansword(char **toks, Sword *s)
+static _Bool scansword(char **toks, Sword *s)
 {
-	scanrect(toks, &s->rightloc[0]);
-	scanrect(toks, &s->rightloc[1]);
-	scanrect(toks, &s->leftloc[0]);
-	scanrect(toks, &s->leftloc[1]);
-	scanint(toks, (int*)&s->dir);
-	scanint(toks, &s->cur);
-	scanint(toks, &s->row);
+	return scanrect(toks, &s->rightloc[0])
+		&& scanrect(toks, &s->rightloc[1])
+		&& scanrect(toks, &s->leftloc[0])
+		&& scanrect(toks, &s->leftloc[1])
+		&& scanint(toks, (int*)&s->dir)
+		&& scanint(toks, &s->cur)
+		&& scanint(toks, &s->row);
 }
 
-static void scanplayer(char **toks, Player *p)
+static _Bool scanplayer(char **toks, Player *p)
 {
-	scanint(toks, (int*) &p->dir);
-	scanint(toks, (int*) &p->act);
-	scanpt(toks, &p->imgloc);
-	scanbody(toks, &p->body);
-	scanbool(toks, &p->acting);
-	scanbool(toks, &p->statup);
-	scandbl(toks, &p->hitback);
-	scanint(toks, &p->jframes);
-	scanint(toks, &p->iframes);
-	scanint(toks, &p->sframes);
-	for (int i = 0; i < StatMax; i++)
-		scanint(toks, &p->stats[i]);
-	for (int i = 0; i < StatMax; i++)
-		scanint(toks, &p->eqp[i]);
-	scanint(toks, &p->curhp);
-	scanint(toks, &p->lives);
-	scanint(toks, &p->money);
-	for (int i = 0; i < Maxinv; i++)
-		scaninvit(toks, &p->inv[i]);
-	for (int i = 0; i < EqpMax; i++)
-		scaninvit(toks, &p->wear[i]);
-	scansword(toks, &p->sw);
+	_Bool ok = scanint(toks, (int*) &p->dir)
+		&& scanint(toks, (int*) &p->act)
+		&& scanpt(toks, &p->imgloc)
+		&& scanbody(toks, &p->body)
+		&& scanbool(toks, &p->acting)
+		&& scanbool(toks, &p->statup)
+		&& scandbl(toks, &p->hitback)
+		&& scanint(toks, &p->jframes)
+		&& scanint(toks, &p->iframes)
+		&& scanint(toks, &p->sframes);
+	for (int i = 0; ok && i < StatMax; i++)
+		ok = scanint(toks, &p->stats[i]);
+	for (int i = 0; ok && i < StatMax; i++)
+		ok = scanint(toks, &p->eqp[i]);
+	ok = ok && scanint(toks, &p->curhp)
+		&& scanint(toks, &p->lives)
+		&& scanint(toks, &p->money);
+	for (int i = 0; ok && i < Maxinv; i++)
+		ok = scaninvit(toks, &p->inv[i]);
+	for (int i = 0; ok && i < EqpMax; i++)
+		ok = scaninvit(toks, &p->wear[i]);
+	return ok && scansword(toks, &p->sw);
+}
+
+/* Scan an optionally signed decimal integer, returning its magnitude
+ * in u.  Like strtol, trailing garbage in the token is ignored. */
+static _Bool scandigits(char **toks, uint64_t *u, _Bool *neg)
+{
+	char *s = nxt(toks);
+	if (!s)
+		return false;
+
+	*neg = *s == '-';
+	if (*s == '-' || *s == '+')
+		s++;
+	if (!isdig(*s))
+		return false;
+
+	uint64_t v = 0;
+	for (; isdig(*s); s++) {
+		unsigned int d = *s - '0';
+		if (v > (UINT64_MAX - d) / 10) {
+			seterrstr("Over/under-flow reading integer");
+			return false;
+		}
+		v = v * 10 + d;
+	}
+	*u = v;
+	*toks = s;
+	if (!isdelim(*s))
+		skiptok(toks);
+	return true;
 }
 
-/* Get the next white/space delimited token. */
+/* Skip to the start of the next blank-delimited token on the line.
+ * Returns NULL at the end of the line.  Unlike strtok, the buffer is
+ * not modified and no state is kept between calls, so separate buffers
+ * can be scanned concurrently. */
 static char *nxt(char **toks)
 {
-	char *t = strtok(*toks, " \t\n\r");
-	if (*toks)
-		*toks = NULL;
-	return t;
+	char *s = *toks;
+	while (*s == ' ' || *s == '\t' || *s == '\r')
+		s++;
+	*toks = s;
+	if (*s == '\0' || *s == '\n')
+		return NULL;
+	return s;
+}
+
+/* Advance past the rest of the current token. */
+static void skiptok(char **toks)
+{
+	char *s = *toks;
+	while (!isdelim(*s))
+		s++;
+	*toks = s;
+}
+
+static _Bool isdelim(int c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0';
+}
+
+static _Bool isdig(int c)
+{
+	return c >= '0' && c <= '9';
 }
 
 _Bool printgeom(char *buf, int sz, char *fmt, ...)
@@ -178,7 +319,7 @@ _Bool printgeom(char *buf, int sz, char *fmt, ...)
 			prfield(&buf, &sz, " %d", va_arg(ap, int));
 			break;
 		case 'f':
-			prfield(&buf, &sz, " %f", va_arg(ap, double));
+			printdbl(&buf, &sz, va_arg(ap, double));
 			break;
 		case 'b':
 			prfield(&buf, &sz, " %d", va_arg(ap, int));
@@ -196,7 +337,7 @@ _Bool printgeom(char *buf, int sz, char *fmt, ...)
 			printplayer(&buf, &sz, va_arg(ap, Player));
 			break;
 		case 'u':
-			prfield(&buf, &sz, " %ull", (unsigned long long) va_arg(ap, uint64_t));
+			prfield(&buf, &sz, " %llu", (unsigned long long) va_arg(ap, uint64_t));
 			break;
 		}
 		itms++;
@@ -209,7 +350,8 @@ _Bool printgeom(char *buf, int sz, char *fmt, ...)
 
 static void printpt(char **bufp, int *szp, Point p)
 {
-	prfield(bufp, szp, " %f %f", p.x, p.y);
+	printdbl(bufp, szp, p.x);
+	printdbl(bufp, szp, p.y);
 }
 
 static void printrect(char **bufp, int *szp, Rect r)
@@ -252,7 +394,7 @@ static void printplayer(char **bufp, int *szp, Player p)
 	printbody(bufp, szp, p.body);
 	prfield(bufp, szp, " %d", p.acting);
 	prfield(bufp, szp, " %d", p.statup);
-	prfield(bufp, szp, " %f", p.hitback);
+	printdbl(bufp, szp, p.hitback);
 	prfield(bufp, szp, " %d", p.jframes);
 	prfield(bufp, szp, " %d", p.iframes);
 	prfield(bufp, szp, " %d", p.sframes);
@@ -270,6 +412,27 @@ static void printplayer(char **bufp, int *szp, Player p)
 	printsword(bufp, szp, p.sw);
 }
 
+/* Print the shortest decimal that reads back as exactly d.  If the
+ * shortest has at most 15 significant digits then %.15g gives it,
+ * trailing zeros trimmed, and 17 digits always suffice.  Most
+ * coordinates are whole numbers, which skip the round trip check. */
+static void printdbl(char **bufp, int *szp, double d)
+{
+	char s[32];
+
+	if (d > -1e15 && d < 1e15 && d == (long long) d && (d != 0 || !signbit(d))) {
+		prfield(bufp, szp, " %lld", (long long) d);
+		return;
+	}
+
+	for (int prec = 15; prec <= 17; prec++) {
+		snprintf(s, sizeof(s), "%.*g", prec, d);
+		if (prec == 17 || strtod(s, NULL) == d)
+			break;
+	}
+	prfield(bufp, szp, " %s", s);
+}
+
 static void prfield(char **bufp, int *szp, char *fmt, ...)
 {
 	va_list ap;
@@ -287,4 +450,204 @@ static void prfield(char **bufp, int *szp, char *fmt, ...)
 	}
 	*bufp += n;
 	*szp -= n;
-}
\ No newline at end of file
+}
+
+int packgeom(char *buf, int sz, char *fmt, ...)
+{
+	va_list ap;
+	Bin b = { (unsigned char*) buf, (unsigned char*) buf + sz, true, true };
+
+	va_start(ap, fmt);
+	for (char *f = fmt; b.ok && *f; f++) {
+		switch (*f) {
+		case 'd': {
+			int d = va_arg(ap, int);
+			binint(&b, &d);
+			break;
+		}
+		case 'f': {
+			double d = va_arg(ap, double);
+			bindbl(&b, &d);
+			break;
+		}
+		case 'b': {
+			_Bool t = va_arg(ap, int);
+			binbool(&b, &t);
+			break;
+		}
+		case 'p': {
+			Point pt = va_arg(ap, Point);
+			binpt(&b, &pt);
+			break;
+		}
+		case 'r': {
+			Rect r = va_arg(ap, Rect);
+			binrect(&b, &r);
+			break;
+		}
+		case 'y': {
+			Body y = va_arg(ap, Body);
+			binbody(&b, &y);
+			break;
+		}
+		case 'l': {
+			Player p = va_arg(ap, Player);
+			binplayer(&b, &p);
+			break;
+		}
+		case 'u': {
+			uint64_t u = va_arg(ap, uint64_t);
+			binbytes(&b, &u, 8);
+			break;
+		}
+		}
+	}
+	va_end(ap);
+
+	if (!b.ok) {
+		seterrstr("Buffer too small to pack %s", fmt);
+		return -1;
+	}
+	return (char*) b.p - buf;
+}
+
+_Bool unpackgeom(char *buf, int sz, char *fmt, ...)
+{
+	va_list ap;
+	Bin b = { (unsigned char*) buf, (unsigned char*) buf + sz, false, true };
+
+	va_start(ap, fmt);
+	for (char *f = fmt; b.ok && *f; f++) {
+		switch (*f) {
+		case 'd': binint(&b, va_arg(ap, int*)); break;
+		case 'f': bindbl(&b, va_arg(ap, double*)); break;
+		case 'b': binbool(&b, va_arg(ap, _Bool*)); break;
+		case 'p': binpt(&b, va_arg(ap, Point*)); break;
+		case 'r': binrect(&b, va_arg(ap, Rect*)); break;
+		case 'y': binbody(&b, va_arg(ap, Body*)); break;
+		case 'l': binplayer(&b, va_arg(ap, Player*)); break;
+		case 'u': binbytes(&b, va_arg(ap, uint64_t*), 8); break;
+		}
+	}
+	va_end(ap);
+
+	if (!b.ok) {
+		seterrstr("Packed %s is truncated", fmt);
+		return false;
+	}
+	if (b.p != b.end) {
+		seterrstr("Packed %s has %d extra bytes", fmt, (int) (b.end - b.p));
+		return false;
+	}
+	return true;
+}
+
+/* Pack or unpack the low n bytes of *v, least significant first. */
+static void binbytes(Bin *b, uint64_t *v, int n)
+{
+	if (!b->ok || b->end - b->p < n) {
+		b->ok = false;
+		return;
+	}
+	if (b->pack) {
+		for (int i = 0; i < n; i++)
+			b->p[i] = *v >> 8*i;
+	} else {
+		*v = 0;
+		for (int i = 0; i < n; i++)
+			*v |= (uint64_t) b->p[i] << 8*i;
+	}
+	b->p += n;
+}
+
+static void binint(Bin *b, int *d)
+{
+	uint64_t v = b->pack ? (uint32_t) *d : 0;
+	binbytes(b, &v, 4);
+	if (!b->pack)
+		*d = v < UINT32_C(1) << 31 ? (int64_t) v : (int64_t) v - (INT64_C(1) << 32);
+}
+
+static void bindbl(Bin *b, double *f)
+{
+	uint64_t v = 0;
+	if (b->pack)
+		memcpy(&v, f, sizeof(v));
+	binbytes(b, &v, 8);
+	if (!b->pack)
+		memcpy(f, &v, sizeof(v));
+}
+
+static void binbool(Bin *b, _Bool *t)
+{
+	uint64_t v = b->pack ? *t : 0;
+	binbytes(b, &v, 1);
+	if (!b->pack)
+		*t = v;
+}
+
+static void binpt(Bin *b, Point *pt)
+{
+	bindbl(b, &pt->x);
+	bindbl(b, &pt->y);
+}
+
+static void binrect(Bin *b, Rect *r)
+{
+	binpt(b, &r->a);
+	binpt(b, &r->b);
+}
+
+static void binbody(Bin *b, Body *y)
+{
+	binrect(b, &y->bbox);
+	if (!b->pack)
+		y->prev = y->bbox.a;
+	binpt(b, &y->vel);
+	binpt(b, &y->acc);
+	binbool(b, &y->fall);
+}
+
+static void bininvit(Bin *b, Invit *it)
+{
+	binint(b, (int*) &it->id);
+	for (int i = 0; i < StatMax; i++)
+		binint(b, &it->stats[i]);
+}
+
+static void binsword(Bin *b, Sword *s)
+{
+	binrect(b, &s->rightloc[0]);
+	binrect(b, &s->rightloc[1]);
+	binrect(b, &s->leftloc[0]);
+	binrect(b, &s->leftloc[1]);
+	binint(b, (int*) &s->dir);
+	binint(b, &s->cur);
+	binint(b, &s->row);
+}
+
+static void binplayer(Bin *b, Player *p)
+{
+	binint(b, (int*) &p->dir);
+	binint(b, (int*) &p->act);
+	binpt(b, &p->imgloc);
+	binbody(b, &p->body);
+	binbool(b, &p->acting);
+	binbool(b, &p->statup);
+	bindbl(b, &p->hitback);
+	binint(b, &p->jframes);
+	binint(b, &p->iframes);
+	binint(b, &p->sframes);
+	for (int i = 0; i < StatMax; i++)
+		binint(b, &p->stats[i]);
+	for (int i = 0; i < StatMax; i++)
+		binint(b, &p->eqp[i]);
+	binint(b, &p->curhp);
+	binint(b, &p->lives);
+	binint(b, &p->money);
+	for (int i = 0; i < Maxinv; i++)
+		bininvit(b, &p->inv[i]);
+	for (int i = 0; i < EqpMax; i++)
+		bininvit(b, &p->wear[i]);
+	binsword(b, &p->sw);
+}
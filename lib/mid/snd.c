@@ -158,6 +158,27 @@ void sfxfree(Sfx *s)
 	xfree(s);
 }
 
+_Bool sfxreload(Sfx *s, const char *path)
+{
+	if(mute)
+		return true;
+
+	Mix_Chunk *c = Mix_LoadWAV(path);
+	if(!c)
+		return false;
+	// Mix_FreeChunk halts any channel still playing the chunk.
+	Mix_FreeChunk(s->c);
+	s->c = c;
+	return true;
+}
+
+unsigned long sfxbytes(const Sfx *s)
+{
+	if(mute || !s->c)
+		return sizeof(*s);
+	return sizeof(*s) + s->c->alen;
+}
+
 void sfxplay(Sfx *s)
 {
 	if(mute)
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <assert.h>
 
+/* Enemies now die into a PartSplat particle, but splats saved in zones
+ * from before then still load as enemies. */
+
 Img *splatimg;
 
 Info splatinfo = {
@@ -26,7 +29,7 @@ _Bool splatinit(Enemy *e, int x, int y){
 		.delay = 200/Ticktm,
 		.w = 32,
 		.h = 32,
-		.d = 200/Ticktm
+		.start = curtick
 	};
 
 	e->data = sp;
@@ -40,19 +43,19 @@ void splatfree(Enemy *e){
 void splatupdate(Enemy *e, Player *p, Zone *z){
 	bodyupdate(&e->body, z->lvl);
 
-	Splat *sp = e->data;
-	sp->anim.sheet = splatimg;
-	animupdate(&sp->anim);
-
 	e->hp--;
 	if(e->hp <= 0)
 		e->id = 0;
 }
 
+void splattouch(Enemy *e, Player *p, Zone *z, int hits){
+	// harmless
+}
+
 void splatdraw(Enemy *e, Gfx *g){
 	Splat *sp = e->data;
 	sp->anim.sheet = splatimg;
-	camdrawanim(g, &sp->anim, e->body.bbox.a);
+	camdrawanim(g, &sp->anim, bodydrawpt(&e->body));
 }
 
 _Bool splatscan(char *buf, Enemy *e){
@@ -69,7 +72,7 @@ _Bool splatscan(char *buf, Enemy *e){
 		.delay = 200/Ticktm,
 		.w = 32,
 		.h = 32,
-		.d = 200/Ticktm
+		.start = curtick
 	};
 
 	e->data = sp;
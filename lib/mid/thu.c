@@ -16,7 +16,7 @@ Info thuinfo = {
 		.item = { ItemNone, ItemNone },
 		.prob = { 99, 1 }
 	},
-	.death = EnemySplat
+	.death = PartSplat
 };
 
 _Bool thuinit(Enemy *e, int x, int y){
@@ -32,6 +32,10 @@ void thuupdate(Enemy *e, Player *p, Zone *z){
 	enemygenupdate(e, p, z, &thuinfo);
 }
 
+void thutouch(Enemy *e, Player *p, Zone *z, int hits){
+	enemygentouch(e, p, z, &thuinfo, hits);
+}
+
 void thudraw(Enemy *e, Gfx *g){
 	if(e->iframes % 4 != 0)
 		return;
@@ -47,7 +51,7 @@ void thudraw(Enemy *e, Gfx *g){
 			{ 32, 0 },
 			{ 64, 32 }
 		};
-	camdrawreg(g, thuimg, clip, e->body.bbox.a);
+	camdrawreg(g, thuimg, clip, bodydrawpt(&e->body));
 }
 
 _Bool thuscan(char *buf, Enemy *e){
@@ -17,7 +17,7 @@ Info untiinfo = {
 		.item = { ItemNone, ItemTopHat },
 		.prob = { 95, 5 }
 	},
-	.death = EnemySplat
+	.death = PartSplat
 };
 
 typedef struct Unti Unti;
@@ -46,9 +46,13 @@ void untiupdate(Enemy *e, Player *p, Zone *z){
 	enemygenupdate(e, p, z, &untiinfo);
 }
 
+void untitouch(Enemy *e, Player *p, Zone *z, int hits){
+	enemygentouch(e, p, z, &untiinfo, hits);
+}
+
 void untidraw(Enemy *e, Gfx *g){
 	if(e->iframes % 4 == 0)
-		camdrawimg(g, untiimg, e->body.bbox.a);
+		camdrawimg(g, untiimg, bodydrawpt(&e->body));
 }
 
 _Bool untiscan(char *buf, Enemy *e){
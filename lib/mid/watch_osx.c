@@ -0,0 +1,24 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+#include "fs.h"
+#include "../../include/mid.h"
+
+Watch *watchnew(void)
+{
+	seterrstr("File watching is only supported on Linux");
+	return NULL;
+}
+
+_Bool watchdir(Watch *w, const char *dir)
+{
+	return false;
+}
+
+_Bool watchnext(Watch *w, char path[PATH_MAX + 1])
+{
+	return false;
+}
+
+void watchfree(Watch *w)
+{
+}
@@ -0,0 +1,111 @@
+/* © 2013 the Mid Authors under the MIT license. See AUTHORS for the list of authors.*/
+
+#include <stdbool.h>
+#include <string.h>
+#include "fs.h"
+#include "../../include/mid.h"
+
+#if defined(__linux__)
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+typedef struct Wdir Wdir;
+struct Wdir {
+	int wd;
+	char dir[PATH_MAX + 1];
+};
+
+struct Watch {
+	int fd;
+	Wdir *dirs;
+	int ndirs;
+	union {
+		struct inotify_event ev;
+		char b[4096];
+	} buf;
+	int off, n;
+};
+
+Watch *watchnew(void)
+{
+	int fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0) {
+		seterrstr("inotify_init1 failed");
+		return NULL;
+	}
+	Watch *w = xalloc(1, sizeof(*w));
+	w->fd = fd;
+	return w;
+}
+
+_Bool watchdir(Watch *w, const char *dir)
+{
+	// Editors often save by writing a new file and renaming it
+	// over the old one, so moves count as changes too.
+	int wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0) {
+		seterrstr("inotify_add_watch failed");
+		return false;
+	}
+	w->dirs = xrealloc(w->dirs, (w->ndirs + 1) * sizeof(*w->dirs));
+	w->dirs[w->ndirs].wd = wd;
+	strncpy(w->dirs[w->ndirs].dir, dir, PATH_MAX);
+	w->dirs[w->ndirs].dir[PATH_MAX] = '\0';
+	w->ndirs++;
+	return true;
+}
+
+_Bool watchnext(Watch *w, char path[PATH_MAX + 1])
+{
+	for (;;) {
+		if (w->off >= w->n) {
+			int n = read(w->fd, w->buf.b, sizeof(w->buf));
+			if (n <= 0)
+				return false;
+			w->n = n;
+			w->off = 0;
+		}
+		struct inotify_event *ev = (void *) (w->buf.b + w->off);
+		w->off += sizeof(*ev) + ev->len;
+		if (ev->len == 0)
+			continue;
+		for (int i = 0; i < w->ndirs; i++) {
+			if (w->dirs[i].wd == ev->wd) {
+				fscat(w->dirs[i].dir, ev->name, path);
+				return true;
+			}
+		}
+	}
+}
+
+void watchfree(Watch *w)
+{
+	close(w->fd);
+	xfree(w->dirs);
+	xfree(w);
+}
+
+#else
+
+Watch *watchnew(void)
+{
+	seterrstr("File watching is only supported on Linux");
+	return NULL;
+}
+
+_Bool watchdir(Watch *w, const char *dir)
+{
+	return false;
+}
+
+_Bool watchnext(Watch *w, char path[PATH_MAX + 1])
+{
+	return false;
+}
+
+void watchfree(Watch *w)
+{
+}
+
+#endif
@@ -18,50 +18,86 @@ _Bool enemyprint(char *, size_t, Enemy *);
 static _Bool readitem(char *buf, Zone *zn);
 static _Bool readenv(char *buf, Zone *zn);
 static _Bool readenemy(char *buf, Zone *zn);
-static _Bool readl(char *buf, int sz, FILE *f);
+static _Bool readz(char **bufp, int *z);
+static char *readall(FILE *f);
+static int linelen(char *buf);
 static _Bool readblkflgs(char *, Lvl *);
+static _Bool scanflgrun(char **bufp, int *n, int *flgs);
+static _Bool scandec(char **bufp, int *v);
 static _Bool blkflgszero(Lvl *lvl, int y, int z);
-static void writeblkflgs(FILE *, Lvl *);
+static void printblkflgs(Buf *, Lvl *);
+static void zonestart(Zone *, int z);
 
-enum { Bufsz = 256 };
+enum { Bufsz = 256, Minflgrun = 3 };
+
+/* Kinds of body in the broadphase. */
+enum { Bpplayer, Bpsword, Bpitem, Bpenemy };
+
+enum { Maxbp = 2 + Maxitms + Maxenms };
+
+/* A body's box in the broadphase. */
+typedef struct Bpent Bpent;
+struct Bpent {
+	Rect box;
+	int kind;
+	int i;	/* the body's slot */
+};
+
+static void zonetouch(Zone *, int z, Player *);
+static void bpsort(Bpent *, int n);
+static void bppair(Bpent *, Bpent *, int *hits, _Bool *grab);
 
 Zone *zoneread(FILE *f)
 {
-	char buf[Bufsz];
-	int itms = 0, envs = 0, enms = 0;
+	char *buf = readall(f);
+	if (!buf)
+		return NULL;
+	Zone *zn = zonescan(buf);
+	xfree(buf);
+	return zn;
+}
 
+Zone *zonescan(char *buf)
+{
 	Zone *zn = xalloc(1, sizeof(*zn));
-	zn->lvl = lvlread(f);
+	zn->lvl = lvlscan(&buf);
 	if (!zn->lvl) {
 		seterrstr("Failed to read the level: %s", miderrstr());
-		return false;
+		xfree(zn);
+		return NULL;
 	}
 
-	while (readl(buf, Bufsz, f)) {
-		if (buf[0] == '\0')
-			continue;
-		switch (buf[0]) {
+	while (*buf != '\0') {
+		char *l = buf;
+		int n = linelen(l);
+		buf += n;
+		if (*buf == '\n')
+			buf++;
+
+		_Bool ok = true;
+		switch (l[0]) {
 		case 'i':
-			if (!readitem(buf+1, zn))
-				return NULL;
-			itms++;
+			ok = readitem(l+1, zn);
 			break;
 		case 'e':
-			if (!readenv(buf+1, zn))
-				return NULL;
-			envs++;
+			ok = readenv(l+1, zn);
 			break;
 		case 'n':
-			if (!readenemy(buf+1, zn))
-				return NULL;
-			enms++;
+			ok = readenemy(l+1, zn);
 			break;
 		case 'f':
-			if (!readblkflgs(buf+1, zn->lvl))
-				return NULL;
+			ok = readblkflgs(l+1, zn->lvl);
 			break;
 		default:
-			seterrstr("Unexpected input line: [%s]", buf);
+			while (n > 0 && isspace((unsigned char) l[n-1]))
+				n--;
+			if (n == 0)
+				continue;
+			seterrstr("Unexpected input line: [%.*s]", n, l);
+			ok = false;
+		}
+		if (!ok) {
+			zonefree(zn);
 			return NULL;
 		}
 	}
@@ -71,20 +107,20 @@ Zone *zoneread(FILE *f)
 
 static _Bool readitem(char *buf, Zone *zn)
 {
-	int z, n;
-	if (sscanf(buf, "%d%n", &z, &n) != 1) {
+	int z;
+	if (!readz(&buf, &z)) {
 		seterrstr("Failed to scan item's z layer");
 		return false;
 	}
 
 	Item it;
-	_Bool ok = itemscan(buf+n, &it);
+	_Bool ok = itemscan(buf, &it);
 	if (!ok) {
-		seterrstr("Failed to scan item [%s]", buf);
+		seterrstr("Failed to scan item [%.*s]", linelen(buf), buf);
 		return false;
 	}
 	if (!zoneadditem(zn, z, it)) {
-		seterrstr("Failed to add item [%s]: too many items", buf);
+		seterrstr("Failed to add item [%.*s]: too many items", linelen(buf), buf);
 		return false;
 	}
 	return true;
@@ -92,20 +128,20 @@ static _Bool readitem(char *buf, Zone *zn)
 
 static _Bool readenv(char *buf, Zone *zn)
 {
-	int z, n;
-	if (sscanf(buf, "%d%n", &z, &n) != 1) {
+	int z;
+	if (!readz(&buf, &z)) {
 		seterrstr("Failed to scan env's z layer");
 		return false;
 	}
 
 	Env env;
-	_Bool ok = envscan(buf+n, &env);
+	_Bool ok = envscan(buf, &env);
 	if (!ok) {
-		seterrstr("Failed to scan env [%s]", buf);
+		seterrstr("Failed to scan env [%.*s]", linelen(buf), buf);
 		return false;
 	}
 	if (!zoneaddenv(zn, z, env)) {
-		seterrstr("Failed to add env [%s]: too many envs", buf);
+		seterrstr("Failed to add env [%.*s]: too many envs", linelen(buf), buf);
 		return false;
 	}
 	return true;
@@ -113,43 +149,70 @@ static _Bool readenv(char *buf, Zone *zn)
 
 static _Bool readenemy(char *buf, Zone *zn)
 {
-	int z, n;
-	if (sscanf(buf, "%d%n", &z, &n) != 1) {
+	int z;
+	if (!readz(&buf, &z)) {
 		seterrstr("Failed to scan enemy's z layer");
 		return false;
 	}
 
 	Enemy en;
-	_Bool ok = enemyscan(buf+n, &en);
+	_Bool ok = enemyscan(buf, &en);
 	if (!ok) {
-		seterrstr("Failed to scan item [%s]", buf);
+		seterrstr("Failed to scan enemy [%.*s]", linelen(buf), buf);
 		return false;
 	}
 	if (!zoneaddenemy(zn, z, en)) {
-		seterrstr("Failed to add enemy [%s]: too many enemies", buf);
+		seterrstr("Failed to add enemy [%.*s]: too many enemies", linelen(buf), buf);
 		return false;
 	}
 	return true;
 }
 
-static _Bool readl(char *buf, int sz, FILE *f)
+static _Bool readz(char **bufp, int *z)
 {
-	char *r = fgets(buf, sz, f);
-	if (!r)
-		return 0;
+	return scanint(bufp, z) && *z >= 0 && *z < Maxz;
+}
 
-	int l = strlen(buf);
+/* Read the rest of f into a NUL-terminated buffer. */
+static char *readall(FILE *f)
+{
+	size_t n = 0, sz = 4096;
+	char *buf = xalloc(sz, 1);
 
-	for(int i = l-1; i >= 0 && isspace(buf[i]); i--)
-		buf[i] = 0;
+	for (;;) {
+		n += fread(buf + n, 1, sz - n - 1, f);
+		if (n < sz - 1)
+			break;
+		sz *= 2;
+		buf = xrealloc(buf, sz);
+	}
+	if (ferror(f)) {
+		seterrstr("Failed to read the zone");
+		xfree(buf);
+		return NULL;
+	}
+	buf[n] = '\0';
+	return buf;
+}
 
-	return 1;
+static int linelen(char *buf)
+{
+	char *e = strchr(buf, '\n');
+	return e ? e - buf : strlen(buf);
 }
 
 void zonewrite(FILE *f, Zone *zn)
 {
-	lvlwrite(f, zn->lvl);
-	writeblkflgs(f, zn->lvl);
+	Buf b = {};
+	zoneprint(&b, zn);
+	fwrite(b.b, 1, b.n, f);
+	xfree(b.b);
+}
+
+void zoneprint(Buf *b, Zone *zn)
+{
+	lvlprint(b, zn->lvl);
+	printblkflgs(b, zn->lvl);
 
 	for (int z = 0; z < Maxz; z++) {
 		Item *itms = zn->itms[z];
@@ -158,7 +221,7 @@ void zonewrite(FILE *f, Zone *zn)
 				continue;
 			char buf[Bufsz];
 			itemprint(buf, Bufsz, &itms[i]);
-			fprintf(f, "i %d %s\n", z, buf);
+			bufprintf(b, "i %d %s\n", z, buf);
 		}
 		Env *envs = zn->envs[z];
 		for (int i = 0; i < Maxenvs; i++) {
@@ -166,7 +229,7 @@ void zonewrite(FILE *f, Zone *zn)
 				continue;
 			char buf[Bufsz];
 			envprint(buf, Bufsz, &envs[i]);
-			fprintf(f, "e %d %s\n", z, buf);
+			bufprintf(b, "e %d %s\n", z, buf);
 		}
 		Enemy *enms = zn->enms[z];
 		for (int i = 0; i < Maxenms; i++) {
@@ -174,7 +237,7 @@ void zonewrite(FILE *f, Zone *zn)
 				continue;
 			char buf[Bufsz];
 			enemyprint(buf, Bufsz, &enms[i]);
-			fprintf(f, "n %d %s\n", z, buf);
+			bufprintf(b, "n %d %s\n", z, buf);
 		}
 	}
 }
@@ -232,6 +295,8 @@ _Bool zoneaddenemy(Zone *zn, int z, Enemy enm)
 
 void zonefree(Zone *z)
 {
+	for (int i = 0; i < Maxz; i++)
+		navfree(z->nav[i]);
 	lvlfree(z->lvl);
 	free(z);
 }
@@ -265,9 +330,10 @@ _Bool zonehasflags(Zone *zn, int z, Point loc, Point wh, unsigned int f)
 		for (int y = loc.y; y < (int) (loc.y + wh.y + 0.5); y++) {
 			if (y < 0 || y >= zn->lvl->h)
 				continue;
-			Tileinfo bi = tileinfo(zn->lvl, x, y, z);
-			if (bi.flags & f)
-				return true;
+			for (int p = 0; p < Nplanes; p++) {
+				if (f & 1 << p && lvlhas(zn->lvl, x, y, z, p))
+					return true;
+			}
 		}
 	}
 	return false;
@@ -283,7 +349,7 @@ _Bool zoneongrnd(Zone *zn, int z, Point loc, Point wh)
 	for (int x = loc.x; x < (int) (loc.x + wh.x + 0.5); x++) {
 		if (x < 0 || x >= zn->lvl->w)
 			return false;
-		if (tileinfo(zn->lvl, x, y, z).flags & Tcollide)
+		if (lvlhas(zn->lvl, x, y, z, Pcollide))
 			return true;
 	}
 	return false;
@@ -316,19 +382,25 @@ _Bool zoneoverlap(Zone *zn, int z, Point loc, Point wh)
 
 void zoneupdate(Zone *zn, Player *p, Point *tr)
 {
-	lvlupdate(zn->lvl);
-	playerupdate(p, zn, tr);
+	int z = zn->lvl->z;
+	zonestart(zn, z);
 
-	itemupdateanims();
+	playerupdate(p, zn, tr);
 
-	int z = zn->lvl->z;
+	// The player may have gone through a door.  The new layer's
+	// bodies were last started whenever the player left it.
+	if (zn->lvl->z != z) {
+		z = zn->lvl->z;
+		zonestart(zn, z);
+	}
+	Nav *nv = zonenav(zn, z);
+	if (nv)
+		navtick(nv);
 
 	Item *itms = zn->itms[z];
 	for(size_t i = 0; i < Maxitms; i++)
 		if (itms[i].id) itemupdate(&itms[i], p, zn);
 
-	envupdateanims();
-
 	Env *en = zn->envs[z];
 	for(size_t i = 0; i < Maxenvs; i++)
 		if (en[i].id) envupdate(&en[i], zn);
@@ -341,6 +413,118 @@ void zoneupdate(Zone *zn, Player *p, Point *tr)
 		if(e[i].hp <= 0)
 			enemyfree(&e[i]);
 	}
+
+	partupdate(&zn->parts[z]);
+
+	zonetouch(zn, z, p);
+}
+
+/* Find what the player and the sword touch, now that everything has
+ * moved, and let the items and enemies react.  The boxes are swept
+ * along x in order of their left edge, so each box is only tested
+ * against the boxes that it overlaps on x. */
+static void zonetouch(Zone *zn, int z, Player *p)
+{
+	Bpent ents[Maxbp];
+	int n = 0;
+
+	ents[n++] = (Bpent) { playerbox(p), Bpplayer, 0 };
+	if (p->sframes > 0)
+		ents[n++] = (Bpent) { swordbbox(&p->sw), Bpsword, 0 };
+
+	Item *itms = zn->itms[z];
+	for (int i = 0; i < Maxitms; i++) {
+		if (itms[i].id)
+			ents[n++] = (Bpent) { itms[i].body.bbox, Bpitem, i };
+	}
+	Enemy *e = zn->enms[z];
+	for (int i = 0; i < Maxenms; i++) {
+		if (e[i].id)
+			ents[n++] = (Bpent) { e[i].body.bbox, Bpenemy, i };
+	}
+	bpsort(ents, n);
+
+	int hits[Maxenms] = { 0 };
+	_Bool grab[Maxitms] = { false };
+	int act[Maxbp];
+	int nact = 0;
+	for (int i = 0; i < n; i++) {
+		int k = 0;
+		for (int j = 0; j < nact; j++) {
+			Bpent *a = &ents[act[j]];
+			if (a->box.b.x <= ents[i].box.a.x)
+				continue;
+			act[k++] = act[j];
+			bppair(a, &ents[i], hits, grab);
+		}
+		nact = k;
+		act[nact++] = i;
+	}
+
+	// Items first, then enemies, each in slot order, as they were
+	// updated.
+	for (int i = 0; i < Maxitms; i++) {
+		if (grab[i])
+			itempickup(&itms[i], p, zn);
+	}
+	for (int i = 0; i < Maxenms; i++) {
+		if (hits[i])
+			enemytouch(&e[i], p, zn, hits[i]);
+	}
+}
+
+/* Sort the boxes by their left edge.  There are at most Maxbp of
+ * them, so an insertion sort beats qsort's indirect compares. */
+static void bpsort(Bpent *ents, int n)
+{
+	for (int i = 1; i < n; i++) {
+		Bpent t = ents[i];
+		int j = i;
+		for (; j > 0 && ents[j-1].box.a.x > t.box.a.x; j--)
+			ents[j] = ents[j-1];
+		ents[j] = t;
+	}
+}
+
+/* Record a and b as touching if one is the player or the sword, the
+ * other is an item or an enemy, and they intersect. */
+static void bppair(Bpent *a, Bpent *b, int *hits, _Bool *grab)
+{
+	if (a->kind > b->kind) {
+		Bpent *t = a;
+		a = b;
+		b = t;
+	}
+	if (a->kind > Bpsword || b->kind <= Bpsword || !isect(a->box, b->box))
+		return;
+
+	if (b->kind == Bpitem) {
+		if (a->kind == Bpplayer)
+			grab[b->i] = true;
+		return;
+	}
+	hits[b->i] |= a->kind == Bpplayer ? Hitplayer : Hitsword;
+}
+
+Nav *zonenav(Zone *zn, int z)
+{
+	if (z < 0 || z >= zn->lvl->d || z >= Maxz)
+		return NULL;
+	if (!zn->nav[z])
+		zn->nav[z] = navnew(zn->lvl, z);
+	return zn->nav[z];
+}
+
+/* Records where the bodies on layer z are at the start of a tick, so
+ * that they can be drawn between ticks. */
+static void zonestart(Zone *zn, int z)
+{
+	for(size_t i = 0; i < Maxitms; i++)
+		bodystart(&zn->itms[z][i].body);
+	for(size_t i = 0; i < Maxenvs; i++)
+		bodystart(&zn->envs[z][i].body);
+	for(size_t i = 0; i < Maxenms; i++)
+		bodystart(&zn->enms[z][i].body);
 }
 
 void zonedraw(Gfx *g, Zone *zn, Player *p)
@@ -363,44 +547,105 @@ void zonedraw(Gfx *g, Zone *zn, Player *p)
 	for(size_t i = 0; i < Maxenms; i++)
 		enemydraw(&e[i], g);
 
+	partdraw(&zn->parts[z], g);
+
 	lvldraw(g, zn->lvl, false);
 
 }
 
-static void writeblkflgs(FILE *f, Lvl *lvl)
+/* Flag rows are run-length encoded: a run of n equal flags is
+ * written as "n*flags", or just "flags" when it is shorter.  Zones
+ * written before runs existed have only single flags, so they read
+ * the same. */
+static void printblkflgs(Buf *b, Lvl *lvl)
 {
 	for (int z = 0; z < lvl->d; z++) {
 	for (int y = 0; y < lvl->h; y++) {
 		if (blkflgszero(lvl, y, z))
 			continue;
 
-		fprintf(f, "f %u %u", z, y);
-		for (int x = 0; x < lvl->w; x++)
-			fprintf(f, " %u", blk(lvl, x, y, z)->flags);
-		fputc('\n', f);
+		bufprintf(b, "f %u %u", z, y);
+		for (int x = 0; x < lvl->w; ) {
+			unsigned int flgs = blk(lvl, x, y, z)->flags;
+			int n = 1;
+			while (x + n < lvl->w && blk(lvl, x + n, y, z)->flags == flgs)
+				n++;
+			if (n >= Minflgrun)
+				bufprintf(b, " %d*%u", n, flgs);
+			else for (int i = 0; i < n; i++)
+				bufprintf(b, " %u", flgs);
+			x += n;
+		}
+		bufput(b, "\n", 1);
 	}
 	}
 }
 
 static _Bool readblkflgs(char *buf, Lvl *lvl)
 {
-	int z, y, n;
+	int z, y;
 
-	if (sscanf(buf, " %u %u%n", &z, &y, &n) != 2) {
+	if (!scanint(&buf, &z) || !scanint(&buf, &y)
+			|| z < 0 || z >= lvl->d || y < 0 || y >= lvl->h) {
 		seterrstr("Failed to read flag row");
 		return false;
 	}
-	buf += n;
 
-	for (int x = 0; x < lvl->w; x++) {
-		unsigned int flgs = 0;
-		if (sscanf(buf, " %u%n", &flgs, &n) != 1) {
+	for (int x = 0; x < lvl->w; ) {
+		int n, flgs;
+		if (!scanflgrun(&buf, &n, &flgs)) {
 			seterrstr("Failed to read flags for block %u, %u, %u", x, y, z);
 			return false;
 		}
-		blk(lvl, x, y, z)->flags = flgs;
-		buf += n;
+		if (n <= 0 || n > lvl->w - x) {
+			seterrstr("Bad flag run length %d at block %u, %u, %u", n, x, y, z);
+			return false;
+		}
+		for (int i = 0; i < n; i++, x++)
+			blk(lvl, x, y, z)->flags = flgs;
+	}
+	return true;
+}
+
+/* Scan a run of flags, either "flags" or "n*flags", advancing *bufp
+ * past it.  This can't use scanint, which would skip over the '*'. */
+static _Bool scanflgrun(char **bufp, int *n, int *flgs)
+{
+	char *p = *bufp;
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	int v;
+	if (!scandec(&p, &v))
+		return false;
+	*n = 1;
+	if (*p == '*') {
+		p++;
+		*n = v;
+		if (!scandec(&p, &v))
+			return false;
+	}
+	*flgs = v;
+	*bufp = p;
+	return true;
+}
+
+/* Scan the decimal digits at *bufp, advancing past them.  Returns
+ * false if there are none or they don't fit in an int. */
+static _Bool scandec(char **bufp, int *v)
+{
+	char *p = *bufp;
+	if (*p < '0' || *p > '9')
+		return false;
+
+	int d = 0;
+	for (; *p >= '0' && *p <= '9'; p++) {
+		if (d > (INT_MAX - (*p - '0')) / 10)
+			return false;
+		d = d * 10 + (*p - '0');
 	}
+	*v = d;
+	*bufp = p;
 	return true;
 }
 
@@ -3,7 +3,18 @@
 #include <stdio.h>
 #include "../../include/os.h"
 #include <sys/stat.h>
+#include <unistd.h>
 
 int makedir(const char *dir){
 	return mkdir(dir, 0700);
 }
+
+int filesync(FILE *f){
+	if(fflush(f) != 0)
+		return -1;
+	return fsync(fileno(f));
+}
+
+int filereplace(const char *tmp, const char *path){
+	return rename(tmp, path);
+}
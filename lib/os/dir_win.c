@@ -3,7 +3,21 @@
 #include <stdio.h>
 #include "../../include/os.h"
 #include <dirent.h>
+#include <io.h>
+#include <windows.h>
 
 int makedir(const char *dir){
 	return _mkdir(dir);
 }
+
+int filesync(FILE *f){
+	if(fflush(f) != 0)
+		return -1;
+	return _commit(_fileno(f));
+}
+
+int filereplace(const char *tmp, const char *path){
+	if(!MoveFileEx(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return -1;
+	return 0;
+}